@@ -0,0 +1,373 @@
+// synthetic benchmarks for the hot paths: build/serialize, open, lookup and read
+//
+// every measurement is printed as a single json object per line, so runs can be diffed or fed
+// into regression tracking directly:
+//   kres_bench --entries 1000,100000,10000000 --min-payload 16 --max-payload 65536 --out b.jsonl
+
+#include <kres.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace kres;
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_config {
+    vec<uint64_t> entry_counts = {1000, 100000};
+    uint64_t min_payload = 16;
+    uint64_t max_payload = 4096;
+    uint64_t lookups = 1000000;
+    uint64_t reads = 10000;
+    uint64_t open_runs = 5;
+    uint64_t seed = 0x6B726573;
+    bool paged = false;  // paged index, see paged.h
+    string dir = ".";
+    string out;  // stdout when empty
+};
+
+static uint64_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // linux reports kilobytes
+#endif
+#endif
+}
+
+static double seconds_since(bench_clock::time_point start) {
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static double nanos_since(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+// asset-like paths, a few top level categories with a skewed fan out underneath, so ids and
+// filename lengths look like a real game/app tree instead of "file_0", "file_1"...
+static string make_path(std::mt19937_64& rng, uint64_t i) {
+    static const char* roots[] = {"textures", "meshes", "audio", "shaders", "config", "ui", "maps"};
+    static const char* exts[] = {".dds", ".mesh", ".ogg", ".spv", ".json", ".png", ".bin"};
+
+    std::geometric_distribution<int> depth_dist(0.45);
+    std::geometric_distribution<int> dir_dist(0.15);
+    size_t kind = rng() % std::size(roots);
+
+    string path = roots[kind];
+    int depth = 1 + std::min(depth_dist(rng), 5);
+    for (int d = 0; d < depth; d++) {
+        path += "/dir_" + std::to_string(dir_dist(rng));
+    }
+    path += "/asset_" + std::to_string(i) + exts[kind];
+    return path;
+}
+
+// log-uniform payload sizes, lots of tiny files with a long tail of large ones
+static uint64_t make_payload_size(std::mt19937_64& rng, const bench_config& cfg) {
+    if (cfg.min_payload >= cfg.max_payload) return cfg.min_payload;
+    std::uniform_real_distribution<double> dist(std::log(static_cast<double>(cfg.min_payload)),
+                                                std::log(static_cast<double>(cfg.max_payload)));
+    return static_cast<uint64_t>(std::exp(dist(rng)));
+}
+
+static vec<entry> make_entries(const bench_config& cfg, uint64_t count, uint64_t* payload_bytes) {
+    std::mt19937_64 rng(cfg.seed ^ count);
+    vec<entry> entries(count);
+    *payload_bytes = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        entry& e = entries[i];
+        e.filename = make_path(rng, i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.size = make_payload_size(rng, cfg);
+        e.data.resize(e.size);
+        uint64_t fill = rng();
+        for (uint64_t b = 0; b < e.size; b++) {
+            e.data[b] = static_cast<std::byte>((fill >> ((b & 7) * 8)) + b);
+        }
+        e.crc32 = crc32(e.data.data(), e.size);
+        *payload_bytes += e.size;
+    }
+
+    return entries;
+}
+
+// builds a single json object line, values are numbers only so no escaping is needed
+struct json_line {
+    std::ostringstream ss;
+
+    json_line(const char* bench, uint64_t entries) {
+        ss << "{\"bench\":\"" << bench << "\",\"entries\":" << entries;
+    }
+
+    json_line& field(const char* key, double val) {
+        ss << ",\"" << key << "\":" << val;
+        return *this;
+    }
+
+    json_line& field(const char* key, uint64_t val) {
+        ss << ",\"" << key << "\":" << val;
+        return *this;
+    }
+
+    // lat_* fields in nanoseconds
+    json_line& percentiles(vec<double>& samples) {
+        if (samples.empty()) return *this;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) {
+            return samples[static_cast<size_t>(q * static_cast<double>(samples.size() - 1))];
+        };
+        return field("lat_p50_ns", at(0.50))
+            .field("lat_p90_ns", at(0.90))
+            .field("lat_p99_ns", at(0.99))
+            .field("lat_p999_ns", at(0.999))
+            .field("lat_max_ns", samples.back());
+    }
+
+    void emit(FILE* f) {
+        ss << ",\"peak_rss\":" << peak_rss_bytes() << "}\n";
+        string s = ss.str();
+        std::fwrite(s.data(), 1, s.size(), f);
+        std::fflush(f);
+    }
+};
+
+static int run_scale(const bench_config& cfg, uint64_t count, FILE* out) {
+    std::mt19937_64 rng(cfg.seed + count);
+    string path = cfg.dir + "/kres_bench_" + std::to_string(count) + ".kres";
+
+    uint64_t payload_bytes;
+    vec<entry> entries = make_entries(cfg, count, &payload_bytes);
+    vec<id> ids;
+    ids.reserve(count);
+    for (const auto& e : entries) ids.push_back(generate_id(e.filename));
+
+    // build + serialize, the header is made once for the whole set, like append_entry with a
+    // directory does
+    {
+        archive ar = init_archive();
+        ar.entries = std::move(entries);  // not needed past this block, and kept out of the timing
+        auto start = bench_clock::now();
+        if (cfg.paged) ar.header.flags |= KRES_FLAG_PAGED_INDEX;
+        if (make_header(&ar) != KRES_OK) return 1;
+        double build_s = seconds_since(start);
+        uint64_t archive_bytes = serialized_size(ar);
+
+        json_line("make_header", count)
+            .field("seconds", build_s)
+            .field("bytes", archive_bytes)
+            .field("mb_per_s", archive_bytes / build_s / 1e6)
+            .emit(out);
+
+        byte_vec serialized;
+        start = bench_clock::now();
+        if (serialize_archive(ar, &serialized) != KRES_OK) return 1;
+        double ser_s = seconds_since(start);
+
+        json_line("serialize_archive", count)
+            .field("seconds", ser_s)
+            .field("bytes", static_cast<uint64_t>(serialized.size()))
+            .field("mb_per_s", serialized.size() / ser_s / 1e6)
+            .emit(out);
+
+        start = bench_clock::now();
+        if (serialize_archive(ar, path) != KRES_OK) {
+            std::fprintf(stderr, "failed to write %s\n", path.c_str());
+            return 1;
+        }
+        double write_s = seconds_since(start);
+
+        json_line("serialize_file", count)
+            .field("seconds", write_s)
+            .field("bytes", archive_bytes)
+            .field("mb_per_s", archive_bytes / write_s / 1e6)
+            .emit(out);
+
+        start = bench_clock::now();
+        if (serialize_archive_parallel(ar, path) != KRES_OK) {
+            std::fprintf(stderr, "failed to write %s\n", path.c_str());
+            return 1;
+        }
+        double parallel_s = seconds_since(start);
+
+        json_line("serialize_file_parallel", count)
+            .field("seconds", parallel_s)
+            .field("bytes", archive_bytes)
+            .field("mb_per_s", archive_bytes / parallel_s / 1e6)
+            .emit(out);
+    }
+    entries = {};
+
+    // open
+    archive ar;
+    {
+        vec<double> samples;
+        for (uint64_t run = 0; run < cfg.open_runs; run++) {
+            ar = {};
+            auto start = bench_clock::now();
+            if (preload_archive(&ar, path) != KRES_OK) return 1;
+            samples.push_back(nanos_since(start));
+        }
+        json_line("preload_archive", count)
+            .field("runs", cfg.open_runs)
+            .percentiles(samples)
+            .emit(out);
+    }
+
+    // lookup, roughly one in ten probes misses
+    {
+        std::uniform_int_distribution<size_t> pick(0, ids.size() - 1);
+        vec<double> samples;
+        samples.reserve(cfg.lookups);
+        uint64_t hits = 0;
+        uint64_t offset;
+        for (uint64_t i = 0; i < cfg.lookups; i++) {
+            id probe = (i % 10 == 9) ? rng() : ids[pick(rng)];
+            auto start = bench_clock::now();
+            hits += find_offset(ar, probe, &offset) == KRES_OK;
+            samples.push_back(nanos_since(start));
+        }
+        json_line("lookup", count)
+            .field("lookups", cfg.lookups)
+            .field("hits", hits)
+            .percentiles(samples)
+            .emit(out);
+    }
+
+    // random reads through the public api
+    {
+        std::uniform_int_distribution<size_t> pick(0, ids.size() - 1);
+        vec<double> samples;
+        samples.reserve(cfg.reads);
+        uint64_t bytes = 0;
+        entry e;
+        auto total_start = bench_clock::now();
+        for (uint64_t i = 0; i < cfg.reads; i++) {
+            auto start = bench_clock::now();
+            if (read_entry(ar, ids[pick(rng)], &e) != KRES_OK) return 1;
+            samples.push_back(nanos_since(start));
+            bytes += e.size;
+        }
+        double total_s = seconds_since(total_start);
+        json_line("read_random", count)
+            .field("reads", cfg.reads)
+            .field("bytes", bytes)
+            .field("mb_per_s", bytes / total_s / 1e6)
+            .percentiles(samples)
+            .emit(out);
+    }
+
+    // sequential scan of every record in file order
+    {
+        map<id, uint64_t> storage;
+        const map<id, uint64_t>* table = nullptr;
+        if (full_index(ar, &storage, &table) != KRES_OK) return 1;
+
+        vec<uint64_t> offsets;
+        offsets.reserve(table->size());
+        for (const auto& [e_id, offset] : *table) offsets.push_back(offset);
+        std::sort(offsets.begin(), offsets.end());
+
+        file_reader r;
+        if (r.open(path.c_str()) != KRES_OK) return 1;
+        uint64_t bytes = 0;
+        entry e;
+        auto start = bench_clock::now();
+        for (uint64_t offset : offsets) {
+            if (read_entry_at(&r, offset, &e) != KRES_OK) return 1;
+            bytes += e.size;
+        }
+        double total_s = seconds_since(start);
+        json_line("read_sequential", count)
+            .field("bytes", bytes)
+            .field("seconds", total_s)
+            .field("mb_per_s", bytes / total_s / 1e6)
+            .emit(out);
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
+
+static vec<uint64_t> parse_list(const char* arg) {
+    vec<uint64_t> out;
+    std::stringstream ss(arg);
+    string item;
+    while (std::getline(ss, item, ',')) out.push_back(std::stoull(item));
+    return out;
+}
+
+static void usage() {
+    std::fprintf(stderr,
+                 "usage: kres_bench [--entries n[,n...]] [--min-payload bytes]\n"
+                 "                  [--max-payload bytes] [--lookups n] [--reads n]\n"
+                 "                  [--open-runs n] [--seed n] [--paged 0|1] [--dir path]\n"
+                 "                  [--out file]\n");
+}
+
+int main(int argc, char** argv) {
+    bench_config cfg;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char* val = argv[++i];
+
+        if (std::strcmp(arg, "--entries") == 0) cfg.entry_counts = parse_list(val);
+        else if (std::strcmp(arg, "--min-payload") == 0) cfg.min_payload = std::stoull(val);
+        else if (std::strcmp(arg, "--max-payload") == 0) cfg.max_payload = std::stoull(val);
+        else if (std::strcmp(arg, "--lookups") == 0) cfg.lookups = std::stoull(val);
+        else if (std::strcmp(arg, "--reads") == 0) cfg.reads = std::stoull(val);
+        else if (std::strcmp(arg, "--open-runs") == 0) cfg.open_runs = std::stoull(val);
+        else if (std::strcmp(arg, "--seed") == 0) cfg.seed = std::stoull(val);
+        else if (std::strcmp(arg, "--paged") == 0) cfg.paged = std::stoull(val) != 0;
+        else if (std::strcmp(arg, "--dir") == 0) cfg.dir = val;
+        else if (std::strcmp(arg, "--out") == 0) cfg.out = val;
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (cfg.min_payload == 0) cfg.min_payload = 1;  // sizes are drawn log-uniform, no room for 0
+
+    FILE* out = stdout;
+    if (!cfg.out.empty()) {
+        out = std::fopen(cfg.out.c_str(), "w");
+        if (!out) {
+            std::fprintf(stderr, "failed to open %s\n", cfg.out.c_str());
+            return 1;
+        }
+    }
+
+    int rc = 0;
+    for (uint64_t count : cfg.entry_counts) {
+        if (count == 0) continue;
+        rc = run_scale(cfg, count, out);
+        if (rc != 0) break;
+    }
+
+    if (out != stdout) std::fclose(out);
+    return rc;
+}
@@ -2,5 +2,21 @@
 #define KRES_H
 
 #include "../kres/main.h"
+#include "../kres/arena.h"
+#include "../kres/async.h"
+#include "../kres/attributes.h"
+#include "../kres/build_cache.h"
+#include "../kres/extract.h"
+#include "../kres/filter.h"
+#include "../kres/generation.h"
+#include "../kres/mount.h"
+#include "../kres/paged.h"
+#include "../kres/prefetch.h"
+#include "../kres/profile.h"
+#include "../kres/remote.h"
+#include "../kres/solid.h"
+#include "../kres/stream.h"
+#include "../kres/view.h"
+#include "../kres/volume.h"
 
 #endif  // KRES_H
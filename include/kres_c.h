@@ -0,0 +1,84 @@
+#ifndef KRES_C_H
+#define KRES_C_H
+
+// c interface for embedding kres in other runtimes (python ctypes/cffi, rust, c#), only opaque
+// handles, plain structs and fixed width integers cross it, so the abi stays the same between
+// releases as long as KRES_C_API_VERSION does
+//
+// entries are handed out as borrowed pointer/length pairs into the archive memory, nothing is
+// copied or allocated per read, kres_read_into copies into a buffer owned by the caller instead.
+// a handle is read only after kres_open, so any number of threads can read through it at once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KRES_C_API_VERSION 1
+
+// return codes, same values as kres::kres_err
+typedef int32_t kres_status;
+enum {
+    KRES_C_INVALID_STATE = -1,
+    KRES_C_OK = 0,
+    KRES_C_ERROR_BUFFER_OVERFLOW = 1,
+    KRES_C_ERROR_INVALID_ARCHIVE = 2,
+    KRES_C_ERROR_INVALID_ARCHIVE_FILE = 3,
+    KRES_C_ERROR_MISMATCHED_VERSION = 4,
+    KRES_C_ERROR_ENTRY_NOT_FOUND = 5,
+    KRES_C_ERROR_DUPLICATE_ENTRY = 6,
+    KRES_C_ERROR_ENTRY_CORRUPTED = 7,
+    KRES_C_ERROR_FAILED_IO = 8,
+    KRES_C_ERROR_EOF = 9,
+    KRES_C_ERROR_INVALID_INPUT_FILE = 10,
+    KRES_C_ERROR_CANCELLED = 11,
+};
+
+typedef struct kres_archive kres_archive;
+
+// borrowed from the archive, valid until kres_close
+typedef struct kres_entry {
+    const char* name;  // null terminated
+    uint64_t name_len;
+    const void* data;
+    uint64_t size;
+    uint32_t crc32;
+} kres_entry;
+
+uint32_t kres_api_version(void);
+
+// maps the archive file read only (read in whole on windows), split archives can't be opened
+kres_status kres_open(const char* path, kres_archive** out);
+// archive already in memory, data is borrowed and has to outlive the handle
+kres_status kres_open_memory(const void* data, uint64_t size, kres_archive** out);
+void kres_close(kres_archive* ar);
+
+// id of an entry name, same as kres::generate_id
+uint64_t kres_id(const char* name, size_t len);
+uint64_t kres_entry_count(const kres_archive* ar);
+kres_status kres_user_section(const kres_archive* ar, const void** data, uint64_t* size);
+
+// finds an entry and points out at it, the payload isn't touched so its crc isn't checked either
+kres_status kres_lookup(const kres_archive* ar, uint64_t id, kres_entry* out);
+kres_status kres_lookup_name(const kres_archive* ar,
+                             const char* name,
+                             size_t len,
+                             kres_entry* out);
+// 1 when the payload matches its crc, 0 otherwise
+int kres_validate(const kres_entry* e);
+
+// copies the payload into buf and checks its crc, size_out always gets the payload size, so a call
+// with a buffer that is too small (KRES_C_ERROR_BUFFER_OVERFLOW) tells how much to allocate
+kres_status kres_read_into(const kres_archive* ar,
+                           uint64_t id,
+                           void* buf,
+                           uint64_t capacity,
+                           uint64_t* size_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // KRES_C_H
@@ -0,0 +1,206 @@
+#include "arena.h"
+
+#include <algorithm>
+
+#include "filter.h"
+#include "io.h"
+#include "paged.h"
+#include "profile.h"
+#include "volume.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace kres {
+
+bool validate_entry(const entry_view& e) {
+    trace_scope trace("checksum", e.data.size());
+    return crc32(e.data.data(), e.data.size()) == e.crc32;
+}
+
+kres_err read_entry_at(file_reader* r,
+                       uint64_t offset,
+                       std::pmr::memory_resource* mem,
+                       entry_view* out) {
+    if (!r || !mem || !out) return KRES_INVALID_STATE;
+
+    auto err = r->seek(offset);
+    if (err != KRES_OK) return err;
+    uint64_t file_size = 0;
+    err = r->size(&file_size);
+    if (err != KRES_OK) return err;
+    uint64_t left = file_size > offset ? file_size - offset : 0;
+
+    err = r->read_u32(&out->filename_len);
+    if (err != KRES_OK) return err;
+
+    // lengths come straight from the file, they are widened and checked against what is left of it
+    // before anything is taken from mem (u32 length, u32 crc and u64 size around the name)
+    uint64_t name_size = uint64_t{out->filename_len} + 1;
+    if (left < 16 || name_size > left - 16) return KRES_ERROR_INVALID_ARCHIVE;
+
+    // name + terminator, straight from the file into the arena
+    auto name = static_cast<char*>(mem->allocate(name_size, 1));
+    err = r->read_into(name, name_size);
+    if (err != KRES_OK) return err;
+    out->filename = std::string_view(name, out->filename_len);
+
+    err = r->read_u32(&out->crc32);
+    if (err != KRES_OK) return err;
+    err = r->read_u64(&out->size);
+    if (err != KRES_OK) return err;
+    if (out->size > left - 16 - name_size) return KRES_ERROR_INVALID_ARCHIVE;
+
+    auto data = static_cast<std::byte*>(mem->allocate(out->size, alignof(std::max_align_t)));
+    err = r->read_into(data, out->size);
+    if (err != KRES_OK) return err;
+    out->data = std::span<const std::byte>(data, out->size);
+
+    return KRES_OK;
+}
+
+#ifndef _WIN32
+static kres_err pread_counted(int fd,
+                              void* dst,
+                              size_t count,
+                              uint64_t offset,
+                              reader_stats* stats) {
+    auto err = pread_all(fd, dst, count, offset);
+    if (stats && err == KRES_OK) {
+        stats->record_io(count);
+        stats->record_copy(count);
+    }
+    return err;
+}
+
+// read_entry_at for a single record, positional reads on a plain fd instead of a file_reader, whose
+// ifstream would allocate its own buffer, so mem is the only thing allocated from. the crc and size
+// are read together with the name, the arena holds those 12 bytes past the terminator
+static kres_err pread_entry_at(int fd,
+                               uint64_t offset,
+                               std::pmr::memory_resource* mem,
+                               reader_stats* stats,
+                               entry_view* out) {
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) return KRES_ERROR_FAILED_IO;
+    auto file_size = static_cast<uint64_t>(st.st_size);
+    uint64_t left = file_size > offset ? file_size - offset : 0;
+
+    std::byte raw[4];
+    auto err = pread_counted(fd, raw, 4, offset, stats);
+    if (err != KRES_OK) return err;
+    out->filename_len = load_le32(raw);
+
+    // same bounds as read_entry_at, checked before anything is taken from mem
+    uint64_t name_size = uint64_t{out->filename_len} + 1;
+    if (left < 16 || name_size > left - 16) return KRES_ERROR_INVALID_ARCHIVE;
+
+    auto name = static_cast<char*>(mem->allocate(name_size + 12, 1));
+    err = pread_counted(fd, name, name_size + 12, offset + 4, stats);
+    if (err != KRES_OK) return err;
+    out->filename = std::string_view(name, out->filename_len);
+    out->crc32 = load_le32(reinterpret_cast<const std::byte*>(name + name_size));
+    out->size = load_le64(reinterpret_cast<const std::byte*>(name + name_size + 4));
+    if (out->size > left - 16 - name_size) return KRES_ERROR_INVALID_ARCHIVE;
+
+    auto data = static_cast<std::byte*>(mem->allocate(out->size, alignof(std::max_align_t)));
+    err = pread_counted(fd, data, out->size, offset + 16 + name_size, stats);
+    if (err != KRES_OK) return err;
+    out->data = std::span<const std::byte>(data, out->size);
+
+    return KRES_OK;
+}
+#endif
+
+kres_err read_entry(const archive& ar,
+                    id entry_id,
+                    std::pmr::memory_resource* mem,
+                    entry_view* out) {
+    if (!mem || !out) return KRES_INVALID_STATE;
+
+    auto start = ar.stats ? stats_clock::now() : stats_clock::time_point{};
+    uint64_t offset = 0;
+    kres_err err = KRES_ERROR_ENTRY_NOT_FOUND;
+    if (may_contain(ar.header, entry_id)) err = find_offset(ar, entry_id, &offset);
+    if (ar.stats) ar.stats->record_lookup(err == KRES_OK, stats_nanos_since(start));
+    if (err != KRES_OK) return err;
+    if (ar.recorder) ar.recorder->record(entry_id);
+
+    trace_scope trace("entry_read", entry_id);
+    start = stats_clock::now();
+#ifdef _WIN32
+    file_reader r;
+    r.stats = ar.stats;
+    err = r.open(volume_path(ar.path, offset_volume(offset)).c_str());
+    if (err != KRES_OK) return err;
+
+    err = read_entry_at(&r, offset_local(offset), mem, out);
+#else
+    // volume_path copies the path even for the first volume, an allocation outside mem
+    uint64_t volume = offset_volume(offset);
+    string split = volume > 0 ? volume_path(ar.path, volume) : string();
+    int fd = ::open(volume > 0 ? split.c_str() : ar.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return KRES_ERROR_INVALID_INPUT_FILE;
+    err = pread_entry_at(fd, offset_local(offset), mem, ar.stats, out);
+    ::close(fd);
+#endif
+    if (ar.stats) ar.stats->read_latency.record(stats_nanos_since(start));
+    return err;
+}
+
+kres_err read_entry(const archive& ar,
+                    const string& filename,
+                    std::pmr::memory_resource* mem,
+                    entry_view* out) {
+    return read_entry(ar, generate_id(filename), mem, out);
+}
+
+kres_err read_entries(const archive& ar,
+                      std::span<const id> ids,
+                      std::pmr::memory_resource* mem,
+                      std::pmr::vector<entry_view>* out) {
+    if (!mem || !out) return KRES_INVALID_STATE;
+
+    // (offset, slot in out), sorted so the file is walked front to back, volume after volume
+    std::pmr::vector<pair<uint64_t, size_t>> order(mem);
+    order.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        auto start = ar.stats ? stats_clock::now() : stats_clock::time_point{};
+        uint64_t offset = 0;
+        kres_err err = KRES_ERROR_ENTRY_NOT_FOUND;
+        if (may_contain(ar.header, ids[i])) err = find_offset(ar, ids[i], &offset);
+        if (ar.stats) ar.stats->record_lookup(err == KRES_OK, stats_nanos_since(start));
+        if (err != KRES_OK) return err;
+        if (ar.recorder) ar.recorder->record(ids[i]);
+        order.emplace_back(offset, i);
+    }
+    std::sort(order.begin(), order.end());
+
+    file_reader r;
+    r.stats = ar.stats;
+    uint64_t volume = UINT64_MAX;
+
+    size_t base = out->size();
+    out->resize(base + ids.size());
+    for (const auto& [offset, slot] : order) {
+        kres_err err;
+        if (offset_volume(offset) != volume) {
+            volume = offset_volume(offset);
+            r.close();
+            err = r.open(volume_path(ar.path, volume).c_str());
+            if (err != KRES_OK) return err;
+        }
+
+        trace_scope trace("entry_read", ids[slot]);
+        auto start = ar.stats ? stats_clock::now() : stats_clock::time_point{};
+        err = read_entry_at(&r, offset_local(offset), mem, &(*out)[base + slot]);
+        if (err != KRES_OK) return err;
+        if (ar.stats) ar.stats->read_latency.record(stats_nanos_since(start));
+    }
+
+    return KRES_OK;
+}
+
+}  // namespace kres
@@ -0,0 +1,50 @@
+#ifndef KRES_ARENA_H
+#define KRES_ARENA_H
+
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+#include "main.h"
+
+namespace kres {
+
+// bump allocator for a batch of reads, everything read through it is released at once when the
+// arena is destroyed or release()d, the initial buffer can live on the stack
+using arena = std::pmr::monotonic_buffer_resource;
+
+// same fields as entry, but filename and data point into memory taken from a memory_resource,
+// the view stays valid for as long as that memory does
+struct entry_view {
+    uint32_t filename_len = 0;
+    std::string_view filename;  // null terminated in memory
+    uint32_t crc32 = 0;
+    uint64_t size = 0;
+    std::span<const std::byte> data;
+};
+
+bool validate_entry(const entry_view& e);
+
+kres_err read_entry_at(file_reader* r,
+                       uint64_t offset,
+                       std::pmr::memory_resource* mem,
+                       entry_view* out);
+kres_err read_entry(const archive& ar,
+                    id entry_id,
+                    std::pmr::memory_resource* mem,
+                    entry_view* out);
+kres_err read_entry(const archive& ar,
+                    const string& filename,
+                    std::pmr::memory_resource* mem,
+                    entry_view* out);
+
+// reads a whole batch through a single open file, records are visited in file order but out keeps
+// the order of ids, fails on the first missing id
+kres_err read_entries(const archive& ar,
+                      std::span<const id> ids,
+                      std::pmr::memory_resource* mem,
+                      std::pmr::vector<entry_view>* out);
+
+}  // namespace kres
+
+#endif  // KRES_ARENA_H
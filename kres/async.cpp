@@ -0,0 +1,86 @@
+#include "async.h"
+
+#include <algorithm>
+
+namespace kres {
+
+thread_pool::thread_pool(uint32_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(threads);
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([this] {
+            for (;;) {
+                std::function<void()> job;
+                {
+                    std::unique_lock lock(mutex);
+                    ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (jobs.empty()) return;  // only when stopping
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void thread_pool::submit(std::function<void()> job) {
+    {
+        std::lock_guard lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    ready.notify_one();
+}
+
+// returning false resumes the caller right away, used for misuse so nothing gets submitted
+bool read_awaitable::await_suspend(std::coroutine_handle<> h) {
+    if (!ar || !executor || !out) {
+        err = KRES_INVALID_STATE;
+        return false;
+    }
+
+    // the awaitable lives in the suspended coroutine's frame, so it is safe to write back into, but
+    // not to touch once the job has been handed over
+    executor->submit([this, h] {
+        err = stop.stop_requested() ? KRES_ERROR_CANCELLED : read_entry(*ar, entry_id, out);
+        h.resume();
+    });
+    return true;
+}
+
+bool batch_awaitable::await_suspend(std::coroutine_handle<> h) {
+    if (!ar || !executor || !out) {
+        first_error = KRES_INVALID_STATE;
+        return false;
+    }
+
+    size_t count = ids.size();
+    async_executor* ex = executor;
+    out->resize(count);
+    pending.store(count);
+    for (size_t i = 0; i < count; i++) {
+        ex->submit([this, h, i] {
+            kres_err err = stop.stop_requested() ? KRES_ERROR_CANCELLED
+                                                 : read_entry(*ar, ids[i], &(*out)[i]);
+            if (err != KRES_OK) {
+                int expected = KRES_OK;
+                first_error.compare_exchange_strong(expected, err);
+            }
+            // whoever finishes last resumes the coroutine, nothing here is touched after that
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) h.resume();
+        });
+    }
+    return true;
+}
+
+}  // namespace kres
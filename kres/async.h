@@ -0,0 +1,105 @@
+#ifndef KRES_ASYNC_H
+#define KRES_ASYNC_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+
+#include "main.h"
+
+namespace kres {
+
+// where async reads actually run, submit has to run every job exactly once on some thread, the
+// awaiting coroutine is resumed on that same thread once its read is done, implement this to hand
+// reads to an existing scheduler or an io backend (io_uring...) instead of the default pool
+struct async_executor {
+    virtual ~async_executor() = default;
+    virtual void submit(std::function<void()> job) = 0;
+};
+
+// default executor, a fixed set of threads that block in the reads so the coroutines don't have to,
+// the destructor runs whatever is still queued before joining
+struct thread_pool final : async_executor {
+    explicit thread_pool(uint32_t threads = 0);  // 0 picks hardware_concurrency
+    ~thread_pool() override;
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    void submit(std::function<void()> job) override;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> jobs;
+    vec<std::thread> workers;
+    bool stopping = false;
+};
+
+// co_await reader.read_entry_async(id, &e) yields the kres_err read_entry would have returned
+struct read_awaitable {
+    const archive* ar;
+    async_executor* executor;
+    id entry_id;
+    entry* out;
+    std::stop_token stop;
+    kres_err err = KRES_OK;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h);
+    kres_err await_resume() const noexcept { return err; }
+};
+
+// all ids are submitted at once and the coroutine resumes when the last read finishes, yields the
+// first error (in completion order), out keeps the order of ids
+struct batch_awaitable {
+    const archive* ar;
+    async_executor* executor;
+    std::span<const id> ids;
+    vec<entry>* out;
+    std::stop_token stop;
+    std::atomic<size_t> pending{0};
+    std::atomic<int> first_error{KRES_OK};
+
+    batch_awaitable(const archive* ar,
+                    async_executor* executor,
+                    std::span<const id> ids,
+                    vec<entry>* out,
+                    std::stop_token stop)
+        : ar(ar), executor(executor), ids(ids), out(out), stop(std::move(stop)) {}
+
+    bool await_ready() const noexcept { return ids.empty(); }
+    bool await_suspend(std::coroutine_handle<> h);
+    kres_err await_resume() const noexcept { return static_cast<kres_err>(first_error.load()); }
+};
+
+// async front end for a preloaded archive, both have to outlive every read issued through it, reads
+// still waiting in the executor when stop is requested finish with KRES_ERROR_CANCELLED without
+// touching the file, reads already running complete normally
+struct async_reader {
+    const archive* ar = nullptr;
+    async_executor* executor = nullptr;  // not owned
+
+    read_awaitable read_entry_async(id entry_id, entry* out, std::stop_token stop = {}) const {
+        return read_awaitable{ar, executor, entry_id, out, std::move(stop)};
+    }
+    read_awaitable read_entry_async(const string& filename,
+                                    entry* out,
+                                    std::stop_token stop = {}) const {
+        return read_entry_async(generate_id(filename), out, std::move(stop));
+    }
+
+    // when_all over ids, ids has to stay alive until the await finishes
+    batch_awaitable read_entries_async(std::span<const id> ids,
+                                       vec<entry>* out,
+                                       std::stop_token stop = {}) const {
+        return batch_awaitable(ar, executor, ids, out, std::move(stop));
+    }
+};
+
+}  // namespace kres
+
+#endif  // KRES_ASYNC_H
@@ -0,0 +1,160 @@
+#include "attributes.h"
+
+#include <algorithm>
+
+#include "paged.h"
+
+namespace kres {
+
+static uint64_t column_bytes(uint64_t rows, uint32_t width) {
+    return (rows * width + 63) / 64 * 64;
+}
+
+uint64_t attribute_section_offset(const header& h) {
+    uint64_t end = index_size(h) + h.user_section_size + root_area_size(h.flags);
+    if (h.flags & KRES_FLAG_PAGED_INDEX) {
+        end = index_pages_offset(h) + index_page_count(h.entry_count) * KRES_INDEX_PAGE_SIZE;
+    }
+    return (end + 63) / 64 * 64;
+}
+
+uint64_t attribute_section_size(const header& h) {
+    uint64_t size = column_bytes(h.entry_count, 8);  // ids
+    for (const auto& column : h.attribute_columns) size += column_bytes(h.entry_count, column.type);
+    return size;
+}
+
+void build_attribute_section(const vec<entry>& entries,
+                             const vec<attribute_column>& columns,
+                             byte_vec* out) {
+    vec<pair<id, size_t>> rows;  // (id, entry index)
+    rows.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        rows.emplace_back(generate_id(entries[i].filename), i);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    uint64_t size = column_bytes(rows.size(), 8);
+    for (const auto& column : columns) size += column_bytes(rows.size(), column.type);
+    out->assign(size, std::byte{0});
+
+    std::byte* pos = out->data();
+    for (size_t r = 0; r < rows.size(); r++) {
+        uint64_t val = host_to_le64(rows[r].first);
+        std::memcpy(pos + r * 8, &val, 8);
+    }
+    pos += column_bytes(rows.size(), 8);
+
+    for (size_t c = 0; c < columns.size(); c++) {
+        for (size_t r = 0; r < rows.size(); r++) {
+            const auto& attributes = entries[rows[r].second].attributes;
+            uint64_t val = c < attributes.size() ? attributes[c] : 0;
+            if (columns[c].type == KRES_ATTR_U32) {
+                uint32_t narrow = host_to_le32(static_cast<uint32_t>(val));
+                std::memcpy(pos + r * 4, &narrow, 4);
+            } else {
+                val = host_to_le64(val);
+                std::memcpy(pos + r * 8, &val, 8);
+            }
+        }
+        pos += column_bytes(rows.size(), columns[c].type);
+    }
+}
+
+kres_err add_attribute_column(archive* ar, const string& name, uint32_t type, size_t* index) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+    if (!index || (type != KRES_ATTR_U32 && type != KRES_ATTR_U64)) return KRES_INVALID_STATE;
+
+    auto& columns = ar->header.attribute_columns;
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].name != name) continue;
+        if (columns[i].type != type) return KRES_INVALID_STATE;
+        *index = i;
+        return KRES_OK;
+    }
+
+    columns.push_back({name, type});
+    ar->header.flags |= KRES_FLAG_ATTRIBUTES;
+    *index = columns.size() - 1;
+    return make_header(ar);
+}
+
+std::span<const uint32_t> attribute_table::u32(size_t column) const {
+    if (column >= columns.size() || columns[column].type != KRES_ATTR_U32) return {};
+    return {reinterpret_cast<const uint32_t*>(data[column].data()), ids.size()};
+}
+
+std::span<const uint64_t> attribute_table::u64(size_t column) const {
+    if (column >= columns.size() || columns[column].type != KRES_ATTR_U64) return {};
+    return {reinterpret_cast<const uint64_t*>(data[column].data()), ids.size()};
+}
+
+size_t attribute_table::find(const string& name) const {
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].name == name) return i;
+    }
+    return SIZE_MAX;
+}
+
+size_t attribute_table::row(id entry_id) const {
+    auto it = std::lower_bound(ids.begin(), ids.end(), entry_id);
+    if (it == ids.end() || *it != entry_id) return SIZE_MAX;
+    return static_cast<size_t>(it - ids.begin());
+}
+
+kres_err load_attributes(const archive& ar, attribute_table* out) {
+    if (!out) return KRES_INVALID_STATE;
+    *out = attribute_table();
+
+    const header& h = ar.header;
+    if (!(h.flags & KRES_FLAG_ATTRIBUTES)) return KRES_OK;
+
+    uint64_t size = attribute_section_size(h);
+    out->storage.resize(size / 8);
+    auto bytes = reinterpret_cast<std::byte*>(out->storage.data());
+
+    if (h.attribute_section.size() == size) {
+        std::memcpy(bytes, h.attribute_section.data(), size);  // built in memory
+    } else {
+        if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+        file_reader r;
+        auto err = r.open(ar.path.c_str());
+        if (err != KRES_OK) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+        err = r.seek(attribute_section_offset(h));
+        if (err != KRES_OK) return err;
+        err = r.read_into(bytes, size);
+        if (err != KRES_OK) return err;
+        if (crc32(bytes, size) != h.attribute_crc) return KRES_ERROR_INVALID_ARCHIVE;
+    }
+
+    uint64_t rows = h.entry_count;
+    out->ids = {reinterpret_cast<const id*>(bytes), rows};
+    out->columns = h.attribute_columns;
+    std::byte* pos = bytes + column_bytes(rows, 8);
+    for (const auto& column : out->columns) {
+        out->data.emplace_back(pos, rows * column.type);
+        pos += column_bytes(rows, column.type);
+    }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // stored little endian, swapped once here so the spans are plain host values
+    auto ids = reinterpret_cast<uint64_t*>(bytes);
+    for (uint64_t r = 0; r < rows; r++) ids[r] = le64_to_host(ids[r]);
+    for (const auto& column : out->data) {
+        auto* p = const_cast<std::byte*>(column.data());
+        for (uint64_t r = 0; r < rows; r++) {
+            if (column.size() == rows * 4) {
+                auto* v = reinterpret_cast<uint32_t*>(p) + r;
+                *v = le32_to_host(*v);
+            } else {
+                auto* v = reinterpret_cast<uint64_t*>(p) + r;
+                *v = le64_to_host(*v);
+            }
+        }
+    }
+#endif
+
+    return KRES_OK;
+}
+
+}  // namespace kres
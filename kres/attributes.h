@@ -0,0 +1,65 @@
+#ifndef KRES_ATTRIBUTES_H
+#define KRES_ATTRIBUTES_H
+
+#include <span>
+
+#include "main.h"
+
+namespace kres {
+
+// archives with KRES_FLAG_ATTRIBUTES (always together with the superblock) carry typed per entry
+// values in columns, one row per entry sorted by id (the order of a paged index), every column a
+// plain little endian array starting on a 64 byte boundary, so a query like "type 3 and bigger than
+// 1 MB" is a loop over a few arrays the compiler can vectorize instead of touching payloads
+//
+// the index only holds the column names and types and a crc of the columns, which come after the
+// user section (and the index pages), preloading never reads them, load_attributes does
+//
+// values are set per entry through entry::attributes, in header::attribute_columns order
+constexpr uint32_t KRES_ATTR_U32 = 4;  // the type is the width in bytes
+constexpr uint32_t KRES_ATTR_U64 = 8;
+
+// where the columns start in the archive file, and their size
+uint64_t attribute_section_offset(const header& h);
+uint64_t attribute_section_size(const header& h);
+
+// encodes the ids and the attribute values of entries into columns, out gets the whole section
+void build_attribute_section(const vec<entry>& entries,
+                             const vec<attribute_column>& columns,
+                             byte_vec* out);
+
+// adds a column to an archive being built (or finds the one with that name, which has to have the
+// same type), index gets its position in entry::attributes, the header is regenerated
+kres_err add_attribute_column(archive* ar, const string& name, uint32_t type, size_t* index);
+
+// the columns of an archive, the ids and every column are in the same row order
+struct attribute_table {
+    std::span<const id> ids;  // sorted
+    vec<attribute_column> columns;
+
+    vec<std::span<const std::byte>> data;  // raw rows of every column
+    vec<uint64_t> storage;                 // everything above points in here
+
+    // typed view of a column, empty when it has another type
+    std::span<const uint32_t> u32(size_t column) const;
+    std::span<const uint64_t> u64(size_t column) const;
+
+    attribute_table() = default;
+    attribute_table(const attribute_table&) = delete;
+    attribute_table& operator=(const attribute_table&) = delete;
+    attribute_table(attribute_table&&) = default;
+    attribute_table& operator=(attribute_table&&) = default;
+
+    // column with that name, SIZE_MAX when there is none
+    size_t find(const string& name) const;
+    // row of an entry, SIZE_MAX when it isn't in the archive
+    size_t row(id entry_id) const;
+};
+
+// reads the columns of a preloaded archive from disk, checked against their crc (built archives
+// are decoded from memory), out is left empty when the archive has none
+kres_err load_attributes(const archive& ar, attribute_table* out);
+
+}  // namespace kres
+
+#endif  // KRES_ATTRIBUTES_H
@@ -0,0 +1,93 @@
+#include "build_cache.h"
+
+#include "paged.h"
+#include "volume.h"
+
+namespace kres {
+
+kres_err set_source_meta(archive* ar, bool enabled) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (enabled) {
+        ar->header.flags |= KRES_FLAG_SOURCE_META;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_SOURCE_META;
+    }
+
+    return make_header(ar);
+}
+
+kres_err load_source_meta(const archive& ar, map<id, file_stat>* out) {
+    if (!out) return KRES_INVALID_STATE;
+    out->clear();
+
+    const header& h = ar.header;
+    if (!(h.flags & KRES_FLAG_SOURCE_META) || h.source_meta_count == 0) return KRES_OK;
+
+    // built in memory, nothing to read
+    if (h.source_meta.size() == h.source_meta_count) {
+        out->reserve(h.source_meta.size());
+        for (const auto& meta : h.source_meta) out->emplace(meta.entry_id, meta);
+        return KRES_OK;
+    }
+    if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+
+    file_reader r;
+    auto err = r.open(ar.path.c_str());
+    if (err != KRES_OK) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+    err = r.seek(h.source_meta_offset);
+    if (err != KRES_OK) return err;
+    byte_vec rows;
+    err = r.read_bytes(h.source_meta_count * 24, &rows);
+    if (err != KRES_OK) return err;
+
+    out->reserve(h.source_meta_count);
+    for (const std::byte* row = rows.data(); row < rows.data() + rows.size(); row += 24) {
+        file_stat meta{load_le64(row), static_cast<int64_t>(load_le64(row + 8)),
+                       load_le64(row + 16)};
+        out->emplace(meta.entry_id, meta);
+    }
+    return KRES_OK;
+}
+
+kres_err reuse_unchanged(archive* ar, const archive& previous, uint64_t* reused) {
+    if (!ar || previous.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+    if (reused) *reused = 0;
+
+    map<id, file_stat> metas;
+    auto err = load_source_meta(previous, &metas);
+    if (err != KRES_OK || metas.empty()) return err;
+
+    map<id, uint64_t> storage;
+    const map<id, uint64_t>* table = nullptr;
+    err = full_index(previous, &storage, &table);
+    if (err != KRES_OK) return err;
+
+    uint64_t count = 0;
+    for (auto& e : ar->entries) {
+        // whole files only, anything with a payload already in memory gains nothing
+        if (e.source_path.empty() || e.source_record || e.source_offset != 0 ||
+            e.source_mtime == 0) {
+            continue;
+        }
+
+        id e_id = generate_id(e.filename);
+        auto meta = metas.find(e_id);
+        if (meta == metas.end() || meta->second.mtime != e.source_mtime ||
+            meta->second.size != e.size) {
+            continue;
+        }
+        auto offset = table->find(e_id);
+        if (offset == table->end()) continue;
+
+        e.source_path = volume_path(previous.path, offset_volume(offset->second));
+        e.source_offset = offset_local(offset->second);
+        e.source_record = true;
+        count++;
+    }
+
+    if (reused) *reused = count;
+    return KRES_OK;
+}
+
+}  // namespace kres
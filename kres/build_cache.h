@@ -0,0 +1,35 @@
+#ifndef KRES_BUILD_CACHE_H
+#define KRES_BUILD_CACHE_H
+
+#include "main.h"
+
+namespace kres {
+
+// archives with KRES_FLAG_SOURCE_META remember the mtime and size of every file their entries were
+// read from (24 bytes per entry in the index), so the next build from the same tree can tell which
+// files haven't changed and carry their records over from the previous archive with range copies,
+// instead of reading and checksumming them again
+//
+//   archive ar = init_archive();
+//   append_entry(&ar, dir, true, true);
+//   set_source_meta(&ar, true);
+//   reuse_unchanged(&ar, previous);          // previous = preload_archive of the last build
+//   serialize_archive(ar, path + ".tmp");    // never over previous itself, then rename
+
+// turns source meta on or off for an archive being built, the header is regenerated (always with a
+// superblock), only entries added from files (append_entry with a path) have any
+kres_err set_source_meta(archive* ar, bool enabled);
+
+// the source meta rows of an archive, read from disk for preloaded archives, out is left empty when
+// it has none
+kres_err load_source_meta(const archive& ar, map<id, file_stat>* out);
+
+// points every deferred file entry of ar whose file still has the mtime and size recorded in
+// previous at its record there (entry::source_record), serializing then copies those records as is,
+// runs of them that follow each other in previous with a single copy, previous has to stay in place
+// until ar is serialized, reused gets the number of entries carried over
+kres_err reuse_unchanged(archive* ar, const archive& previous, uint64_t* reused = nullptr);
+
+}  // namespace kres
+
+#endif  // KRES_BUILD_CACHE_H
@@ -0,0 +1,178 @@
+#include "../include/kres_c.h"
+
+#include <cstring>
+#include <new>
+
+#include "view.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// the c codes are spelled out in kres_c.h, they must never drift from kres_err
+static_assert(KRES_C_INVALID_STATE == int{kres::KRES_INVALID_STATE} &&
+              KRES_C_ERROR_ENTRY_CORRUPTED == int{kres::KRES_ERROR_ENTRY_CORRUPTED} &&
+              KRES_C_ERROR_CANCELLED == int{kres::KRES_ERROR_CANCELLED});
+
+struct kres_archive {
+    kres::archive_view view;
+
+    // memory of archives opened from a path, borrowed ones leave these empty
+#ifdef _WIN32
+    kres::byte_vec owned;
+#else
+    void* map = nullptr;
+    uint64_t map_size = 0;
+#endif
+
+    ~kres_archive() {
+#ifndef _WIN32
+        if (map) ::munmap(map, map_size);
+#endif
+    }
+};
+
+static void fill_entry(const kres::entry_view& e, kres_entry* out) {
+    out->name = e.filename.data();
+    out->name_len = e.filename_len;
+    out->data = e.data.data();
+    out->size = e.size;
+    out->crc32 = e.crc32;
+}
+
+extern "C" {
+
+uint32_t kres_api_version(void) { return KRES_C_API_VERSION; }
+
+kres_status kres_open(const char* path, kres_archive** out) {
+    if (!path || !out) return KRES_C_INVALID_STATE;
+    *out = nullptr;
+
+    // nothing may unwind into the caller
+    auto* ar = new (std::nothrow) kres_archive;
+    if (!ar) return KRES_C_INVALID_STATE;
+    kres::kres_err err = kres::KRES_OK;
+    try {
+#ifdef _WIN32
+        kres::file_reader r;
+        err = r.open(path);
+        uint64_t size = err == kres::KRES_OK ? std::filesystem::file_size(path) : 0;
+        if (err == kres::KRES_OK) err = r.read_bytes(size, &ar->owned);
+        if (err == kres::KRES_OK) err = kres::open_archive_view(ar->owned, &ar->view);
+#else
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        struct stat st {};
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            err = kres::KRES_ERROR_INVALID_ARCHIVE_FILE;
+        } else {
+            ar->map_size = static_cast<uint64_t>(st.st_size);
+            void* m = MAP_FAILED;
+            if (ar->map_size > 0) {
+                m = ::mmap(nullptr, ar->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            if (m == MAP_FAILED) {
+                err = ar->map_size == 0 ? kres::KRES_ERROR_INVALID_ARCHIVE
+                                        : kres::KRES_ERROR_FAILED_IO;
+            } else {
+                ar->map = m;
+                err = kres::open_archive_view(
+                    std::span(static_cast<const std::byte*>(m), ar->map_size), &ar->view);
+            }
+        }
+        if (fd >= 0) ::close(fd);  // the mapping keeps the file alive
+#endif
+    } catch (...) {
+        err = kres::KRES_INVALID_STATE;
+    }
+
+    if (err != kres::KRES_OK) {
+        delete ar;
+        return err;
+    }
+    *out = ar;
+    return KRES_C_OK;
+}
+
+kres_status kres_open_memory(const void* data, uint64_t size, kres_archive** out) {
+    if (!data || !out) return KRES_C_INVALID_STATE;
+    *out = nullptr;
+
+    auto* ar = new (std::nothrow) kres_archive;
+    if (!ar) return KRES_C_INVALID_STATE;
+    kres::kres_err err;
+    try {
+        err = kres::open_archive_view(std::span(static_cast<const std::byte*>(data), size),
+                                      &ar->view);
+    } catch (...) {
+        err = kres::KRES_INVALID_STATE;
+    }
+
+    if (err != kres::KRES_OK) {
+        delete ar;
+        return err;
+    }
+    *out = ar;
+    return KRES_C_OK;
+}
+
+void kres_close(kres_archive* ar) { delete ar; }
+
+uint64_t kres_id(const char* name, size_t len) { return XXH3_64bits(name, len); }
+
+uint64_t kres_entry_count(const kres_archive* ar) { return ar ? ar->view.entry_count : 0; }
+
+kres_status kres_user_section(const kres_archive* ar, const void** data, uint64_t* size) {
+    if (!ar || !data || !size) return KRES_C_INVALID_STATE;
+    *data = ar->view.user_section.data();
+    *size = ar->view.user_section.size();
+    return KRES_C_OK;
+}
+
+kres_status kres_lookup(const kres_archive* ar, uint64_t id, kres_entry* out) {
+    if (!ar || !out) return KRES_C_INVALID_STATE;
+
+    kres::entry_view e;
+    auto err = kres::read_entry(ar->view, id, &e);
+    if (err != kres::KRES_OK) return err;
+    fill_entry(e, out);
+    return KRES_C_OK;
+}
+
+kres_status kres_lookup_name(const kres_archive* ar,
+                             const char* name,
+                             size_t len,
+                             kres_entry* out) {
+    if (!name) return KRES_C_INVALID_STATE;
+    return kres_lookup(ar, kres_id(name, len), out);
+}
+
+int kres_validate(const kres_entry* e) {
+    if (!e) return 0;
+    return crc32(e->data, e->size) == e->crc32;
+}
+
+kres_status kres_read_into(const kres_archive* ar,
+                           uint64_t id,
+                           void* buf,
+                           uint64_t capacity,
+                           uint64_t* size_out) {
+    if (!ar || !size_out) return KRES_C_INVALID_STATE;
+
+    kres::entry_view e;
+    auto err = kres::read_entry(ar->view, id, &e);
+    if (err != kres::KRES_OK) return err;
+    *size_out = e.size;
+    if (e.size > capacity) return KRES_C_ERROR_BUFFER_OVERFLOW;
+    if (e.size == 0) return KRES_C_OK;
+    if (!buf) return KRES_C_INVALID_STATE;
+
+    // checked on the copy, which is what the caller ends up with
+    std::memcpy(buf, e.data.data(), e.size);
+    if (crc32(buf, e.size) != e.crc32) return KRES_C_ERROR_ENTRY_CORRUPTED;
+    return KRES_C_OK;
+}
+
+}  // extern "C"
@@ -0,0 +1,266 @@
+#include "extract.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "io.h"
+#include "paged.h"
+#include "volume.h"
+
+namespace kres {
+
+struct extract_job {
+    id entry_id;
+    uint64_t volume;
+    uint64_t record_offset;  // inside the volume file
+    uint64_t data_offset;
+    uint64_t size;
+    uint32_t crc32;
+    std::filesystem::path out_path;
+};
+
+static bool safe_relative(const std::filesystem::path& p) {
+    if (p.empty() || p.is_absolute() || p.has_root_name()) return false;
+    for (const auto& part : p) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+// record prefixes are read in file order, payloads are left for the workers
+static kres_err collect_jobs(const archive& ar,
+                             const string& prefix,
+                             const std::filesystem::path& root,
+                             vec<extract_job>* out) {
+    map<id, uint64_t> storage;
+    const map<id, uint64_t>* table = nullptr;
+    auto err = full_index(ar, &storage, &table);
+    if (err != KRES_OK) return err;
+
+    vec<pair<uint64_t, id>> records;
+    records.reserve(table->size());
+    for (const auto& [e_id, offset] : *table) records.emplace_back(offset, e_id);
+    std::sort(records.begin(), records.end());
+
+    file_reader r;
+    r.stats = ar.stats;
+    uint64_t volume = UINT64_MAX;
+
+    string filename;
+    uint64_t volumes = std::max<size_t>(ar.header.volume_sizes.size(), 1);
+    for (const auto& [encoded, e_id] : records) {
+        if (offset_volume(encoded) >= volumes) return KRES_ERROR_INVALID_ARCHIVE;
+        if (offset_volume(encoded) != volume) {
+            volume = offset_volume(encoded);
+            r.close();
+            err = r.open(volume_path(ar.path, volume).c_str());
+            if (err != KRES_OK) return err;
+        }
+
+        uint64_t offset = offset_local(encoded);
+        uint32_t filename_len;
+        extract_job job;
+        err = r.seek(offset);
+        if (err != KRES_OK) return err;
+        err = r.read_u32(&filename_len);
+        if (err != KRES_OK) return err;
+        err = r.read_string(&filename);
+        if (err != KRES_OK) return err;
+
+        if (!filename.starts_with(prefix)) continue;
+
+        std::filesystem::path rel(filename);
+        if (!safe_relative(rel.lexically_normal())) return KRES_ERROR_INVALID_ARCHIVE;
+
+        err = r.read_u32(&job.crc32);
+        if (err != KRES_OK) return err;
+        err = r.read_u64(&job.size);
+        if (err != KRES_OK) return err;
+
+        job.entry_id = e_id;
+        job.volume = volume;
+        job.record_offset = offset;
+        job.data_offset = offset + 4 + filename_len + 1 + 4 + 8;
+        job.out_path = root / rel;
+        out->push_back(std::move(job));
+    }
+
+    // split archives hand out one job per volume in turn, so the workers read every volume at once
+    // instead of draining them one after another
+    if (volumes > 2 && !out->empty()) {
+        vec<vec<extract_job>> per_volume(volumes);
+        for (auto& job : *out) per_volume[job.volume].push_back(std::move(job));
+
+        size_t total = out->size();
+        out->clear();
+        for (size_t i = 0; out->size() < total; i++) {
+            for (auto& jobs : per_volume) {
+                if (i < jobs.size()) out->push_back(std::move(jobs[i]));
+            }
+        }
+    }
+
+    return KRES_OK;
+}
+
+#ifdef __linux__
+struct extract_source {
+    int fd = -1;
+    const std::byte* map = nullptr;
+    uint64_t map_size = 0;
+};
+
+static kres_err extract_one(const vec<extract_source>& sources,
+                            const extract_job& job,
+                            reader_stats* stats) {
+    const extract_source& src = sources[job.volume];
+    auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+    bool valid = crc32(src.map + job.data_offset, job.size) == job.crc32;
+    if (stats) stats->record_checksum(stats_nanos_since(start));
+    if (!valid) return KRES_ERROR_ENTRY_CORRUPTED;
+
+    int out_fd = ::open(job.out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out_fd < 0) return KRES_ERROR_FAILED_IO;
+
+    auto err = copy_range(src.fd, out_fd, job.data_offset, job.size);
+    if (stats && err == KRES_OK) stats->record_io(job.size);
+    if (::close(out_fd) != 0 && err == KRES_OK) err = KRES_ERROR_FAILED_IO;
+    return err;
+}
+
+static void release_sources(vec<extract_source>* sources) {
+    for (auto& src : *sources) {
+        if (src.map) ::munmap(const_cast<std::byte*>(src.map), src.map_size);
+        if (src.fd >= 0) ::close(src.fd);
+    }
+}
+#else
+struct extract_source {
+    string path;
+};
+
+static kres_err extract_one(const vec<extract_source>& sources,
+                            const extract_job& job,
+                            reader_stats* stats) {
+    const extract_source& src = sources[job.volume];
+    thread_local file_reader r;
+    thread_local string open_path;
+    if (open_path != src.path) {
+        r.close();
+        auto err = r.open(src.path.c_str());
+        if (err != KRES_OK) return err;
+        open_path = src.path;
+    }
+    r.stats = stats;
+
+    entry e;
+    auto err = read_entry_at(&r, job.record_offset, &e);
+    if (err != KRES_OK) return err;
+    if (!validate_entry(e, stats)) return KRES_ERROR_ENTRY_CORRUPTED;
+
+    std::ofstream file(job.out_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return KRES_ERROR_FAILED_IO;
+    file.write(reinterpret_cast<const char*>(e.data.data()), static_cast<std::streamsize>(e.size));
+    return file.good() ? KRES_OK : KRES_ERROR_FAILED_IO;
+}
+#endif
+
+kres_err extract_prefix(const archive& ar,
+                        const string& prefix,
+                        const string& out_dir,
+                        uint32_t threads) {
+    if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+    trace_scope trace("extract", ar.header.entry_count);
+
+    std::filesystem::path root(out_dir);
+    vec<extract_job> jobs;
+    auto err = collect_jobs(ar, prefix, root, &jobs);
+    if (err != KRES_OK) return err;
+
+    // the whole tree is created up front so workers only ever create files
+    std::error_code ec;
+    std::filesystem::create_directories(root, ec);
+    if (ec) return KRES_ERROR_FAILED_IO;
+    for (const auto& job : jobs) {
+        std::filesystem::create_directories(job.out_path.parent_path(), ec);
+        if (ec) return KRES_ERROR_FAILED_IO;
+    }
+
+    // one source per volume file, volume 0 of a split archive holds no records and is never opened
+    vec<extract_source> sources(std::max<size_t>(ar.header.volume_sizes.size(), 1));
+    vec<bool> used(sources.size(), false);
+    for (const auto& job : jobs) used[job.volume] = true;
+
+    for (size_t v = 0; v < sources.size(); v++) {
+        if (!used[v]) continue;
+        extract_source& src = sources[v];
+        string path = volume_path(ar.path, v);
+#ifdef __linux__
+        src.map_size = std::filesystem::file_size(path, ec);
+        if (!ec) src.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        void* m = src.fd < 0 ? MAP_FAILED
+                             : ::mmap(nullptr, src.map_size, PROT_READ, MAP_PRIVATE, src.fd, 0);
+        if (m == MAP_FAILED) {
+            release_sources(&sources);
+            return KRES_ERROR_FAILED_IO;
+        }
+        src.map = static_cast<const std::byte*>(m);
+#else
+        src.path = path;
+#endif
+    }
+
+#ifdef __linux__
+    for (const auto& job : jobs) {
+        if (job.data_offset + job.size > sources[job.volume].map_size) {
+            release_sources(&sources);
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+    }
+#endif
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<uint32_t>(std::min<size_t>(threads, std::max<size_t>(jobs.size(), 1)));
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> first_error{KRES_OK};
+    auto worker = [&] {
+        while (first_error.load(std::memory_order_relaxed) == KRES_OK) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= jobs.size()) return;
+
+            trace_scope job_trace("entry_read", jobs[i].entry_id);
+            auto job_err = extract_one(sources, jobs[i], ar.stats);
+            if (job_err != KRES_OK) {
+                std::error_code remove_ec;
+                std::filesystem::remove(jobs[i].out_path, remove_ec);
+                int expected = KRES_OK;
+                first_error.compare_exchange_strong(expected, job_err);
+            }
+        }
+    };
+
+    vec<std::thread> pool;
+    for (uint32_t t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+#ifdef __linux__
+    release_sources(&sources);
+#endif
+
+    return static_cast<kres_err>(first_error.load());
+}
+
+kres_err extract_all(const archive& ar, const string& out_dir, uint32_t threads) {
+    return extract_prefix(ar, "", out_dir, threads);
+}
+
+}  // namespace kres
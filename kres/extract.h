@@ -0,0 +1,26 @@
+#ifndef KRES_EXTRACT_H
+#define KRES_EXTRACT_H
+
+#include "main.h"
+
+namespace kres {
+
+// unpacks a preloaded archive into out_dir, recreating the directory tree from entry names, entries
+// are spread over threads (0 picks hardware_concurrency), on linux payloads are copied archive fd
+// to output fd in the kernel with copy_file_range (sendfile as fallback) and checksummed from a
+// read only mapping of the archive, so they never pass through a userspace buffer
+//
+// an entry whose crc doesn't match is deleted again and fails the whole extraction with
+// KRES_ERROR_ENTRY_CORRUPTED, names escaping out_dir (absolute, "..") fail with
+// KRES_ERROR_INVALID_ARCHIVE before anything is written
+kres_err extract_all(const archive& ar, const string& out_dir, uint32_t threads = 0);
+
+// same, but only entries whose name starts with prefix
+kres_err extract_prefix(const archive& ar,
+                        const string& prefix,
+                        const string& out_dir,
+                        uint32_t threads = 0);
+
+}  // namespace kres
+
+#endif  // KRES_EXTRACT_H
@@ -0,0 +1,102 @@
+#include "filter.h"
+
+namespace kres {
+
+kres_err set_id_filter(archive* ar, bool enabled) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (enabled) {
+        ar->header.flags |= KRES_FLAG_ID_FILTER;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_ID_FILTER;
+        ar->header.id_filter.clear();
+    }
+
+    return make_header(ar);
+}
+
+kres_err read_id_filter(file_reader* r, uint64_t entry_count, vec<filter_block>* out) {
+    if (!r || !out) return KRES_INVALID_STATE;
+
+    uint64_t block_count;
+    auto err = r->read_u64(&block_count);
+    if (err != KRES_OK) return err;
+    if (block_count != filter_block_count(entry_count)) return KRES_ERROR_INVALID_ARCHIVE;
+
+    byte_vec raw;
+    err = r->read_bytes(block_count * sizeof(filter_block), &raw);
+    if (err != KRES_OK) return err;
+
+    out->resize(block_count);
+    const std::byte* pos = raw.data();
+    for (auto& block : *out) {
+        for (uint32_t& word : block.words) {
+            word = load_le32(pos);
+            pos += 4;
+        }
+    }
+    return KRES_OK;
+}
+
+kres_err load_id_filter(const string& filename, vec<filter_block>* out) {
+    if (!out) return KRES_INVALID_STATE;
+    out->clear();
+
+    file_reader r;
+    auto err = r.open(filename.c_str());
+    if (err != KRES_OK) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+
+    uint32_t magic, version, flags;
+    uint64_t entry_count, skip;
+    err = r.read_u32(&magic);
+    if (err != KRES_OK) return err;
+    if (magic != KRES_MAGIC) return KRES_ERROR_INVALID_ARCHIVE;
+    err = r.read_u32(&version);
+    if (err != KRES_OK) return err;
+    err = r.read_u32(&flags);
+    if (err != KRES_OK) return err;
+    if (flags & ~KRES_FLAGS_KNOWN) return KRES_ERROR_MISMATCHED_VERSION;
+    if (!(flags & KRES_FLAG_ID_FILTER)) return KRES_OK;
+    if (flags & KRES_FLAG_GENERATIONS) {
+        // the filter that counts is in the index of the current generation, wherever that is
+        archive ar;
+        err = preload_archive(&ar, filename);
+        if (err != KRES_OK) return err;
+        *out = std::move(ar.header.id_filter);
+        return KRES_OK;
+    }
+    err = r.read_u64(&entry_count);
+    if (err != KRES_OK) return err;
+
+    // offset table (or page fence), then the user section, which superblock archives keep at the
+    // end instead
+    if (flags & KRES_FLAG_SUPERBLOCK) {
+        err = r.skip(KRES_SUPERBLOCK_SIZE - KRES_FIXED_HEADER_SIZE);
+        if (err != KRES_OK) return err;
+    }
+    if (flags & KRES_FLAG_PAGED_INDEX) {
+        err = r.read_u64(&skip);  // fence of a paged index
+        if (err != KRES_OK) return err;
+        err = r.skip(skip * 12);
+    } else {
+        err = r.skip(entry_count * 16);
+    }
+    if (err != KRES_OK) return err;
+    if (!(flags & KRES_FLAG_SUPERBLOCK)) {
+        err = r.read_u64(&skip);
+        if (err != KRES_OK) return err;
+        err = r.skip(skip);
+        if (err != KRES_OK) return err;
+    }
+
+    if (flags & KRES_FLAG_SOLID) {
+        err = r.read_u64(&skip);
+        if (err != KRES_OK) return err;
+        err = r.skip(skip * 16);
+        if (err != KRES_OK) return err;
+    }
+
+    return read_id_filter(&r, entry_count, out);
+}
+
+}  // namespace kres
@@ -0,0 +1,64 @@
+#ifndef KRES_FILTER_H
+#define KRES_FILTER_H
+
+#include <span>
+
+#include "main.h"
+
+namespace kres {
+
+// split block bloom filter over entry ids, an id picks one 32 byte block and sets one bit in each
+// of its 8 words, so a lookup touches a single cache line, ids are already xxh3 hashes so they are
+// used as is, at 16 bits per entry about 1 in 1000 absent ids gets through to the offset table
+constexpr uint64_t KRES_FILTER_BITS_PER_ENTRY = 16;
+
+inline uint64_t filter_block_count(uint64_t entry_count) {
+    uint64_t bits = entry_count * KRES_FILTER_BITS_PER_ENTRY;
+    return bits == 0 ? 1 : (bits + 255) / 256;
+}
+
+namespace detail {
+constexpr uint32_t filter_salt[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                     0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+inline size_t filter_block_index(id entry_id, size_t block_count) {
+    return static_cast<size_t>(((entry_id >> 32) * block_count) >> 32);
+}
+}  // namespace detail
+
+inline void filter_insert(std::span<filter_block> filter, id entry_id) {
+    auto& block = filter[detail::filter_block_index(entry_id, filter.size())];
+    auto key = static_cast<uint32_t>(entry_id);
+    for (int i = 0; i < 8; i++) block.words[i] |= 1u << ((key * detail::filter_salt[i]) >> 27);
+}
+
+// false means the id is definitely not there, an empty filter lets everything through
+inline bool filter_may_contain(std::span<const filter_block> filter, id entry_id) {
+    if (filter.empty()) return true;
+
+    const auto& block = filter[detail::filter_block_index(entry_id, filter.size())];
+    auto key = static_cast<uint32_t>(entry_id);
+    uint32_t missing = 0;
+    for (int i = 0; i < 8; i++) {
+        missing |= ~block.words[i] & (1u << ((key * detail::filter_salt[i]) >> 27));
+    }
+    return missing == 0;
+}
+
+inline bool may_contain(const header& h, id entry_id) {
+    return filter_may_contain(h.id_filter, entry_id);
+}
+
+// turns the id filter on or off for an archive being built, the header is regenerated
+kres_err set_id_filter(archive* ar, bool enabled);
+
+// reads the filter section at the reader's position, block count first
+kres_err read_id_filter(file_reader* r, uint64_t entry_count, vec<filter_block>* out);
+
+// reads just the filter of an archive on disk, the offset table and user section are skipped over
+// instead of loaded, out is left empty when the archive has no filter
+kres_err load_id_filter(const string& filename, vec<filter_block>* out);
+
+}  // namespace kres
+
+#endif  // KRES_FILTER_H
@@ -0,0 +1,213 @@
+#include "generation.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+#include "build_cache.h"
+#include "filter.h"
+#include "io.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kres {
+
+void encode_root_slot(const root_slot& slot, std::byte* out) {
+    uint64_t fields[3] = {host_to_le64(slot.generation), host_to_le64(slot.index_offset),
+                          host_to_le64(slot.index_size)};
+    std::memcpy(out, fields, 24);
+    uint32_t crc = host_to_le32(crc32(out, 24));
+    std::memcpy(out + 24, &crc, 4);
+    std::memset(out + 28, 0, 4);
+}
+
+bool latest_root_slot(const std::byte* area, root_slot* out, int* which) {
+    bool found = false;
+    for (int i = 0; i < 2; i++) {
+        const std::byte* slot = area + i * KRES_ROOT_SLOT_SIZE;
+        if (crc32(slot, 24) != load_le32(slot + 24)) continue;  // never written, or torn
+
+        root_slot s{load_le64(slot), load_le64(slot + 8), load_le64(slot + 16)};
+        if (found && s.generation <= out->generation) continue;
+        *out = s;
+        if (which) *which = i;
+        found = true;
+    }
+    return found;
+}
+
+kres_err set_generations(archive* ar, bool enabled) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (enabled) {
+        ar->header.flags |= KRES_FLAG_GENERATIONS;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_GENERATIONS;
+    }
+
+    return make_header(ar);
+}
+
+kres_err open_latest_generation(file_reader* r, header* h) {
+    if (!r || !h) return KRES_INVALID_STATE;
+
+    std::byte area[2 * KRES_ROOT_SLOT_SIZE];
+    auto err = r->seek(h->root_offset);
+    if (err != KRES_OK) return err;
+    err = r->read_into(area, sizeof(area));
+    if (err != KRES_OK) return err;
+
+    root_slot root;
+    if (!latest_root_slot(area, &root)) return KRES_ERROR_INVALID_ARCHIVE;
+    if (root.index_offset == 0) return KRES_OK;  // still generation 0, which h already is
+    if (root.index_size < KRES_SUPERBLOCK_SIZE + 8) return KRES_ERROR_INVALID_ARCHIVE;
+
+    byte_vec buf(root.index_size);
+    err = r->seek(root.index_offset);
+    if (err != KRES_OK) return err;
+    err = r->read_into(buf.data(), buf.size());
+    if (err != KRES_OK) return err;
+
+    header latest;
+    err = parse_index(buf, &latest, false);
+    if (err != KRES_OK) return err;
+    if (!(latest.flags & KRES_FLAG_GENERATIONS)) return KRES_ERROR_INVALID_ARCHIVE;
+
+    // parsed on its own, so everything located in it is relative to where it starts
+    latest.generation = root.generation;
+    latest.index_offset = root.index_offset;
+    latest.root_offset = h->root_offset;
+    latest.user_section_offset += root.index_offset;
+    latest.source_meta_offset += root.index_offset;
+    *h = std::move(latest);
+    return KRES_OK;
+}
+
+#ifndef _WIN32
+// the commit itself, with fd opened for writing, everything goes through positional writes
+static kres_err commit_locked(int fd, archive* ar, vec<entry>&& added, const vec<id>& removed) {
+    if (::flock(fd, LOCK_EX) != 0) return KRES_ERROR_FAILED_IO;  // released when fd is closed
+
+    const header& current = ar->header;
+    std::byte area[2 * KRES_ROOT_SLOT_SIZE];
+    auto err = pread_all(fd, area, sizeof(area), current.root_offset);
+    if (err != KRES_OK) return err;
+    root_slot root;
+    int which = 0;
+    if (!latest_root_slot(area, &root, &which)) return KRES_ERROR_INVALID_ARCHIVE;
+    if (root.generation != current.generation) return KRES_INVALID_STATE;  // committed meanwhile
+
+    header next;
+    next.version = current.version;
+    next.flags = current.flags;
+    next.solid_entry_limit = current.solid_entry_limit;
+    next.solid_block_size = current.solid_block_size;
+    next.block_table = current.block_table;  // blocks are never rewritten, only skipped
+    next.offset_table = current.offset_table;
+    next.user_section_size = current.user_section_size;
+    err = read_user_section(*ar, &next.user_section);
+    if (err != KRES_OK) return err;
+
+    map<id, file_stat> metas;
+    err = load_source_meta(*ar, &metas);
+    if (err != KRES_OK) return err;
+    for (id entry_id : removed) {
+        next.offset_table.erase(entry_id);
+        metas.erase(entry_id);
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) return KRES_ERROR_FAILED_IO;
+    auto records_offset = static_cast<uint64_t>(st.st_size);
+
+    archive batch;
+    batch.entries = std::move(added);
+    std::unordered_set<id> seen;
+    uint64_t offset = records_offset;
+    for (const auto& e : batch.entries) {
+        id e_id = generate_id(e.filename);
+        if (!seen.insert(e_id).second) return KRES_ERROR_DUPLICATE_ENTRY;
+
+        next.offset_table[e_id] = offset;
+        offset += record_size(e);
+        metas.erase(e_id);
+        if (e.source_mtime != 0) metas[e_id] = file_stat{e_id, e.source_mtime, e.size};
+    }
+
+    next.entry_count = next.offset_table.size();
+    if (next.flags & KRES_FLAG_ID_FILTER) {
+        next.id_filter.resize(filter_block_count(next.entry_count));
+        for (const auto& [entry_id, at] : next.offset_table) {
+            filter_insert(next.id_filter, entry_id);
+        }
+    }
+    if (next.flags & KRES_FLAG_SOURCE_META) {
+        next.source_meta.reserve(metas.size());
+        for (const auto& [entry_id, meta] : metas) next.source_meta.push_back(meta);
+        std::sort(next.source_meta.begin(), next.source_meta.end(),
+                  [](const file_stat& a, const file_stat& b) { return a.entry_id < b.entry_id; });
+        next.source_meta_count = next.source_meta.size();
+    }
+    next.index_offset = offset;  // after the new records
+
+    // the new index is a complete header of its own, written like any other
+    archive image;
+    image.header = std::move(next);
+    byte_vec index;
+    err = serialize_archive(image, &index);
+    next = std::move(image.header);
+    if (err != KRES_OK) return err;
+
+    err = write_records_at(ar->path, batch, records_offset);
+    if (err != KRES_OK) return err;
+    err = pwrite_all(fd, index.data(), index.size(), next.index_offset);
+    if (err != KRES_OK) return err;
+
+    // everything the root points at is on disk before the root is, and the root before we return
+    if (::fsync(fd) != 0) return KRES_ERROR_FAILED_IO;
+    root_slot published{root.generation + 1, next.index_offset, index_size(next)};
+    std::byte slot[KRES_ROOT_SLOT_SIZE];
+    encode_root_slot(published, slot);
+    err = pwrite_all(fd, slot, sizeof(slot),
+                     current.root_offset + (which ^ 1) * KRES_ROOT_SLOT_SIZE);
+    if (err != KRES_OK) return err;
+    if (::fsync(fd) != 0) return KRES_ERROR_FAILED_IO;
+
+    next.generation = published.generation;
+    next.root_offset = current.root_offset;
+    next.user_section_offset = next.index_offset + published.index_size;
+    ar->header = std::move(next);
+    return KRES_OK;
+}
+#endif
+
+kres_err commit_generation(archive* ar, vec<entry>&& added, const vec<id>& removed) {
+    if (!ar || ar->path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+
+    // fixed size pages, attribute columns and volume files would all have to be rewritten
+    uint32_t flags = ar->header.flags;
+    if (!(flags & KRES_FLAG_GENERATIONS) ||
+        (flags & (KRES_FLAG_PAGED_INDEX | KRES_FLAG_VOLUMES | KRES_FLAG_ATTRIBUTES))) {
+        return KRES_INVALID_STATE;
+    }
+
+#ifdef _WIN32
+    // no positional writes or advisory locks to build this on yet
+    (void)added;
+    (void)removed;
+    return KRES_INVALID_STATE;
+#else
+    int fd = ::open(ar->path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return KRES_ERROR_FAILED_IO;
+    auto err = commit_locked(fd, ar, std::move(added), removed);
+    if (::close(fd) != 0 && err == KRES_OK) err = KRES_ERROR_FAILED_IO;
+    return err;
+#endif
+}
+
+}  // namespace kres
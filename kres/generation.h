@@ -0,0 +1,53 @@
+#ifndef KRES_GENERATION_H
+#define KRES_GENERATION_H
+
+#include "main.h"
+
+namespace kres {
+
+// archives with KRES_FLAG_GENERATIONS (always together with the superblock) can be appended to in
+// place while readers have them open. a commit never touches bytes that are already there, it adds
+// the new records and then a complete new index (a regular superblock header) at the end of the
+// file, and only then publishes it through one of two root slots that follow the user section of
+// the original header:
+//
+//   u64 generation | u64 index offset | u64 index size | u32 crc of the first 24 bytes | u32 0
+//
+// the slot with the highest generation whose crc matches is the current root, a commit overwrites
+// the other one, so a crash or a torn write at any point leaves the previous generation in place.
+// readers pick the root once when they open the archive and keep that snapshot without any locks,
+// everything it points at stays where it is. generation 0 is the header at the start of the file
+//
+//   archive ar = preload_archive(path)           // any generation
+//   commit_generation(&ar, std::move(added), removed);
+//
+// replaced and removed records stay in the file as garbage until the archive is repacked
+struct root_slot {
+    uint64_t generation = 0;
+    uint64_t index_offset = 0;  // 0 for generation 0
+    uint64_t index_size = 0;    // index_size of the header found there
+};
+
+void encode_root_slot(const root_slot& slot, std::byte* out);
+// the current root of the two slots in area (2 * KRES_ROOT_SLOT_SIZE bytes), which gets the slot it
+// was in, false when neither is valid
+bool latest_root_slot(const std::byte* area, root_slot* out, int* which = nullptr);
+
+// turns generations on or off for an archive being built, the header is regenerated, paged, split
+// and attribute archives can be built with it but not committed to
+kres_err set_generations(archive* ar, bool enabled);
+
+// called by preload_archive once generation 0 is parsed, replaces h with the header of the current
+// generation, r is the reader of the archive file
+kres_err open_latest_generation(file_reader* r, header* h);
+
+// appends the entries to the file a preloaded archive was opened from, as a new generation, and
+// moves ar to it. added entries replace those with the same name, removed ones drop out of the
+// index. writers lock the file against each other (readers never do) and a commit on an archive
+// that isn't at the current generation anymore fails with KRES_INVALID_STATE, preload it again and
+// redo the change. data is synced before the root is published and again after
+kres_err commit_generation(archive* ar, vec<entry>&& added, const vec<id>& removed = {});
+
+}  // namespace kres
+
+#endif  // KRES_GENERATION_H
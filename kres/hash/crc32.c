@@ -100,16 +100,19 @@ const uint32_t crc32_tab[] = {
     0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
     0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d};
 
-uint32_t crc32(const void* buf, size_t size) {
+uint32_t crc32_update(uint32_t crc, const void* buf, size_t size) {
     const uint8_t* p = buf;
-    uint32_t crc;
 
-    crc = ~0U;
+    crc = crc ^ ~0U;
     while (size--)
         crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
     return crc ^ ~0U;
 }
 
+uint32_t crc32(const void* buf, size_t size) {
+    return crc32_update(0, buf, size);
+}
+
 /*
  * A function that calculates the CRC-32 based on the table above is
  * given below for documentation purposes. An equivalent implementation
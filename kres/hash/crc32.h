@@ -9,6 +9,8 @@ extern "C" {
 #endif
 
 uint32_t crc32(const void* buf, size_t size);
+/* continues a crc32 over more data, crc32_update(crc32(a), b) == crc32(a + b), start with 0 */
+uint32_t crc32_update(uint32_t crc, const void* buf, size_t size);
 
 uint32_t calculate_crc32c(uint32_t crc32c, const unsigned char* buffer, unsigned int length);
 
@@ -0,0 +1,217 @@
+#ifndef XXH3_CONSTEXPR_H
+#define XXH3_CONSTEXPR_H
+
+#include <cstdint>
+#include <string_view>
+
+// compile time XXH3_64bits (seed 0, default secret), produces the exact same values as the xxHash
+// library so ids computed here match kres::generate_id at runtime, it's a straight port of the
+// scalar reference code and not meant to be fast when called at runtime
+
+namespace kres::xxh3 {
+
+inline constexpr uint8_t secret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline constexpr uint64_t PRIME32_1 = 0x9E3779B1U;
+inline constexpr uint64_t PRIME32_2 = 0x85EBCA77U;
+inline constexpr uint64_t PRIME32_3 = 0xC2B2AE3DU;
+inline constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+inline constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+inline constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+inline constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+inline constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+inline constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+inline constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+constexpr uint64_t read32(const uint8_t* p) {
+    return uint64_t{p[0]} | (uint64_t{p[1]} << 8) | (uint64_t{p[2]} << 16) | (uint64_t{p[3]} << 24);
+}
+
+constexpr uint64_t read64(const uint8_t* p) { return read32(p) | (read32(p + 4) << 32); }
+
+constexpr uint64_t read32(std::string_view s, size_t i) {
+    return uint64_t{static_cast<uint8_t>(s[i])} | (uint64_t{static_cast<uint8_t>(s[i + 1])} << 8) |
+           (uint64_t{static_cast<uint8_t>(s[i + 2])} << 16) |
+           (uint64_t{static_cast<uint8_t>(s[i + 3])} << 24);
+}
+
+constexpr uint64_t read64(std::string_view s, size_t i) {
+    return read32(s, i) | (read32(s, i + 4) << 32);
+}
+
+constexpr uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+constexpr uint64_t swap64(uint64_t x) {
+    uint64_t out = 0;
+    for (int i = 0; i < 8; i++) out |= ((x >> (i * 8)) & 0xFF) << ((7 - i) * 8);
+    return out;
+}
+
+// 64x64 -> 128 multiply folded to 64 bits, done in 32 bit halves so it works without __int128
+constexpr uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs) {
+    uint64_t lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    uint64_t hi_lo = (lhs >> 32) * (rhs & 0xFFFFFFFF);
+    uint64_t lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    uint64_t hi_hi = (lhs >> 32) * (rhs >> 32);
+
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+}
+
+constexpr uint64_t xxh64_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+constexpr uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+constexpr uint64_t rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    h ^= h >> 28;
+    return h;
+}
+
+constexpr uint64_t mix16(std::string_view s, size_t i, const uint8_t* sec) {
+    return mul128_fold64(read64(s, i) ^ read64(sec), read64(s, i + 8) ^ read64(sec + 8));
+}
+
+constexpr uint64_t len_0to16(std::string_view s) {
+    size_t len = s.size();
+    if (len > 8) {
+        uint64_t lo = read64(s, 0) ^ (read64(secret + 24) ^ read64(secret + 32));
+        uint64_t hi = read64(s, len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return avalanche(len + swap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t in1 = read32(s, 0);
+        uint64_t in2 = read32(s, len - 4);
+        uint64_t keyed = (in2 + (in1 << 32)) ^ (read64(secret + 8) ^ read64(secret + 16));
+        return rrmxmx(keyed, len);
+    }
+    if (len > 0) {
+        uint64_t c1 = static_cast<uint8_t>(s[0]);
+        uint64_t c2 = static_cast<uint8_t>(s[len >> 1]);
+        uint64_t c3 = static_cast<uint8_t>(s[len - 1]);
+        uint64_t combined = (c1 << 16) | (c2 << 24) | c3 | (uint64_t{len} << 8);
+        return xxh64_avalanche(combined ^ (read32(secret) ^ read32(secret + 4)));
+    }
+    return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+constexpr uint64_t len_17to128(std::string_view s) {
+    size_t len = s.size();
+    uint64_t acc = len * PRIME64_1;
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16(s, 48, secret + 96);
+                acc += mix16(s, len - 64, secret + 112);
+            }
+            acc += mix16(s, 32, secret + 64);
+            acc += mix16(s, len - 48, secret + 80);
+        }
+        acc += mix16(s, 16, secret + 32);
+        acc += mix16(s, len - 32, secret + 48);
+    }
+    acc += mix16(s, 0, secret);
+    acc += mix16(s, len - 16, secret + 16);
+    return avalanche(acc);
+}
+
+constexpr uint64_t len_129to240(std::string_view s) {
+    size_t len = s.size();
+    uint64_t acc = len * PRIME64_1;
+    for (size_t i = 0; i < 8; i++) acc += mix16(s, 16 * i, secret + 16 * i);
+    uint64_t acc_end = mix16(s, len - 16, secret + 136 - 17);
+    acc = avalanche(acc);
+    for (size_t i = 8; i < len / 16; i++) acc_end += mix16(s, 16 * i, secret + 16 * (i - 8) + 3);
+    return avalanche(acc + acc_end);
+}
+
+constexpr void accumulate_512(uint64_t* acc, std::string_view s, size_t i, const uint8_t* sec) {
+    for (size_t lane = 0; lane < 8; lane++) {
+        uint64_t data_val = read64(s, i + 8 * lane);
+        uint64_t data_key = data_val ^ read64(sec + 8 * lane);
+        acc[lane ^ 1] += data_val;
+        acc[lane] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+    }
+}
+
+constexpr void scramble(uint64_t* acc, const uint8_t* sec) {
+    for (size_t lane = 0; lane < 8; lane++) {
+        uint64_t a = acc[lane];
+        a ^= a >> 47;
+        a ^= read64(sec + 8 * lane);
+        a *= PRIME32_1;
+        acc[lane] = a;
+    }
+}
+
+constexpr uint64_t hash_long(std::string_view s) {
+    constexpr size_t stripe_len = 64;
+    constexpr size_t stripes_per_block = (sizeof(secret) - stripe_len) / 8;
+    constexpr size_t block_len = stripe_len * stripes_per_block;
+
+    size_t len = s.size();
+    uint64_t acc[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                       PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+
+    size_t blocks = (len - 1) / block_len;
+    for (size_t b = 0; b < blocks; b++) {
+        for (size_t n = 0; n < stripes_per_block; n++) {
+            accumulate_512(acc, s, b * block_len + n * stripe_len, secret + n * 8);
+        }
+        scramble(acc, secret + sizeof(secret) - stripe_len);
+    }
+
+    size_t stripes = ((len - 1) - block_len * blocks) / stripe_len;
+    for (size_t n = 0; n < stripes; n++) {
+        accumulate_512(acc, s, blocks * block_len + n * stripe_len, secret + n * 8);
+    }
+    accumulate_512(acc, s, len - stripe_len, secret + sizeof(secret) - stripe_len - 7);
+
+    uint64_t result = len * PRIME64_1;
+    for (size_t i = 0; i < 4; i++) {
+        result += mul128_fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i),
+                                acc[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+constexpr uint64_t hash64(std::string_view s) {
+    if (s.size() <= 16) return len_0to16(s);
+    if (s.size() <= 128) return len_17to128(s);
+    if (s.size() <= 240) return len_129to240(s);
+    return hash_long(s);
+}
+
+}  // namespace kres::xxh3
+
+#endif  // XXH3_CONSTEXPR_H
@@ -0,0 +1,205 @@
+#ifndef KRES_IO_H
+#define KRES_IO_H
+
+// small posix helpers shared by the writers and the extractor, everything here loops until the
+// whole request is done, so callers never have to deal with short writes
+
+#include <algorithm>
+
+#include "types.h"
+
+#ifndef _WIN32
+#include <cerrno>
+
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace kres {
+
+#ifndef _WIN32
+// writev until every iovec is drained, partial writes just advance the window
+inline kres_err write_all(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = ::writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+
+        auto left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return KRES_OK;
+}
+
+// same as write_all, but at offset instead of the file position, so several threads can fill
+// different parts of one fd at once
+inline kres_err pwritev_all(int fd, iovec* iov, int count, uint64_t offset) {
+    while (count > 0) {
+        ssize_t written = ::pwritev(fd, iov, count, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        offset += static_cast<uint64_t>(written);
+
+        auto left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return KRES_OK;
+}
+
+inline kres_err pwrite_all(int fd, const void* data, size_t size, uint64_t offset) {
+    auto p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return KRES_OK;
+}
+
+inline kres_err pread_all(int fd, void* data, size_t size, uint64_t offset) {
+    auto p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        if (n == 0) return KRES_ERROR_EOF;
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return KRES_OK;
+}
+
+// reads exactly size bytes, KRES_ERROR_EOF when the other end is done before the first byte
+inline kres_err read_all(int fd, void* data, size_t size) {
+    auto p = static_cast<char*>(data);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::read(fd, p + done, size - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        if (n == 0) return done == 0 ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
+        done += static_cast<size_t>(n);
+    }
+    return KRES_OK;
+}
+#endif
+
+#ifdef __linux__
+// sends size bytes starting at offset in in_fd to a socket (or pipe), straight from the page cache
+inline kres_err send_range(int in_fd, int out_fd, uint64_t offset, uint64_t size) {
+    auto off = static_cast<off_t>(offset);
+    while (size > 0) {
+        ssize_t n = ::sendfile(out_fd, in_fd, &off, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        if (n == 0) return KRES_ERROR_EOF;
+        size -= static_cast<uint64_t>(n);
+    }
+    return KRES_OK;
+}
+
+// copies size bytes starting at offset in in_fd to the current position of out_fd without the data
+// leaving the kernel, copy_file_range first (may even reflink), sendfile where that isn't supported
+inline kres_err copy_range(int in_fd, int out_fd, uint64_t offset, uint64_t size) {
+    auto in_off = static_cast<loff_t>(offset);
+    bool use_copy_file_range = true;
+
+    while (size > 0) {
+        ssize_t n = -1;
+        if (use_copy_file_range) {
+            n = ::copy_file_range(in_fd, &in_off, out_fd, nullptr, size, 0);
+            if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                          errno == EOPNOTSUPP)) {
+                use_copy_file_range = false;  // old kernel or odd filesystem, sendfile still works
+                continue;
+            }
+        } else {
+            auto off = static_cast<off_t>(in_off);
+            n = ::sendfile(out_fd, in_fd, &off, size);
+            if (n > 0) in_off = off;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        if (n == 0) return KRES_ERROR_EOF;
+        size -= static_cast<uint64_t>(n);
+    }
+    return KRES_OK;
+}
+
+// copy_range to out_offset instead of the file position of out_fd, sendfile can't write at an
+// offset so the fallback goes through a buffer
+inline kres_err copy_range_at(int in_fd, int out_fd, uint64_t offset, uint64_t out_offset,
+                              uint64_t size) {
+    auto in_off = static_cast<loff_t>(offset);
+    auto out_off = static_cast<loff_t>(out_offset);
+    while (size > 0) {
+        ssize_t n = ::copy_file_range(in_fd, &in_off, out_fd, &out_off, size, 0);
+        if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+                      errno == EOPNOTSUPP)) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        if (n == 0) return KRES_ERROR_EOF;
+        size -= static_cast<uint64_t>(n);
+    }
+
+    byte_vec buf(std::min<uint64_t>(size, 1024 * 1024));
+    while (size > 0) {
+        size_t len = static_cast<size_t>(std::min<uint64_t>(size, buf.size()));
+        auto err = pread_all(in_fd, buf.data(), len, static_cast<uint64_t>(in_off));
+        if (err != KRES_OK) return err;
+        err = pwrite_all(out_fd, buf.data(), len, static_cast<uint64_t>(out_off));
+        if (err != KRES_OK) return err;
+        in_off += static_cast<loff_t>(len);
+        out_off += static_cast<loff_t>(len);
+        size -= len;
+    }
+    return KRES_OK;
+}
+#endif
+
+}  // namespace kres
+
+#endif  // KRES_IO_H
@@ -1,6 +1,29 @@
 #include "main.h"
-
-#include <__msvc_filebuf.hpp>
+#include "io.h"
+#include "attributes.h"
+#include "filter.h"
+#include "generation.h"
+#include "paged.h"
+#include "profile.h"
+#include "solid.h"
+#include "volume.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace kres {
 
@@ -19,7 +42,7 @@ bool validate_archive(const byte_vec& data) {
 // part of the new api, allows for validating from disk
 bool validate_archive(const string& filename) {
     archive ar;
-    if (!preload_archive(&ar, filename)) return false;
+    if (preload_archive(&ar, filename) != KRES_OK) return false;
 
     version_t v = version_decode(ar.header.version);
     version_t current = version_decode(KRES_VERSION);
@@ -28,41 +51,829 @@ bool validate_archive(const string& filename) {
 }
 
 bool validate_entry(const entry& entry) {
+    trace_scope trace("checksum", entry.data.size());
     uint32_t computed_crc = crc32(entry.data.data(), entry.data.size());
     return computed_crc == entry.crc32;
 }
 
+bool validate_entry(const entry& entry, reader_stats* stats) {
+    if (!stats) return validate_entry(entry);
+
+    auto start = stats_clock::now();
+    bool valid = validate_entry(entry);
+    stats->record_checksum(stats_nanos_since(start));
+    return valid;
+}
+
+uint64_t header_size(const header& h) {
+    if (h.flags & KRES_FLAG_ATTRIBUTES) {
+        return attribute_section_offset(h) + attribute_section_size(h);
+    }
+    if (h.flags & KRES_FLAG_PAGED_INDEX) {
+        return index_pages_offset(h) + index_page_count(h.entry_count) * KRES_INDEX_PAGE_SIZE;
+    }
+    return index_size(h) + h.user_section_size + root_area_size(h.flags);
+}
+
+uint64_t index_size(const header& h) {
+    uint64_t size = KRES_FIXED_HEADER_SIZE;  // magic, version, flags, entry_count
+    if (h.flags & KRES_FLAG_SUPERBLOCK) size = KRES_SUPERBLOCK_SIZE;
+    if (h.flags & KRES_FLAG_PAGED_INDEX) {
+        size += 8 + index_page_count(h.entry_count) * 12;  // page count + fence
+    } else {
+        size += h.entry_count * 16;  // offset table (id + offset per entry)
+    }
+    size += 8;  // user section size
+    if (h.flags & KRES_FLAG_SOLID) size += 8 + h.block_table.size() * 16;  // block count + table
+    if (h.flags & KRES_FLAG_ID_FILTER) size += 8 + h.id_filter.size() * sizeof(filter_block);
+    if (h.flags & KRES_FLAG_VOLUMES) size += 8 + 8 + h.volume_sizes.size() * 8;  // cap + count
+    if (h.flags & KRES_FLAG_SOURCE_META) size += 8 + h.source_meta_count * 24;
+    if (h.flags & KRES_FLAG_ATTRIBUTES) {
+        size += 8 + 4;  // column count + crc of the columns
+        for (const auto& column : h.attribute_columns) size += 4 + 4 + column.name.size();
+    }
+    return size;
+}
+
+uint32_t header_crc(const std::byte* index, uint64_t size) {
+    constexpr uint64_t crc_pos = KRES_SUPERBLOCK_SIZE - 4;
+    uint32_t crc = crc32(index, crc_pos);
+    return crc32_update(crc, index + KRES_SUPERBLOCK_SIZE, size - KRES_SUPERBLOCK_SIZE);
+}
+
+uint64_t record_size(const entry& e) { return 4 + e.filename.length() + 1 + 4 + 8 + e.size; }
+
+uint64_t serialized_size(const archive& arch) {
+    uint64_t size = header_size(arch.header);
+    for (const auto& entry : arch.entries) size += record_size(entry);
+    return size;
+}
+
+static void write_header(byte_writer* writer, const header& h) {
+    bool superblock = h.flags & KRES_FLAG_SUPERBLOCK;
+    size_t start = writer->buffer->size();
+
+    writer->write_u32(h.magic);
+    writer->write_u32(h.version);
+    writer->write_u32(h.flags);
+    writer->write_u64(h.entry_count);
+    if (superblock) {
+        writer->write_u64(header_size(h));
+        writer->write_u64(index_size(h));
+        writer->write_u32(0);  // crc, patched in once the index is complete
+    }
+
+    byte_vec pages;
+    if (h.flags & KRES_FLAG_PAGED_INDEX) {
+        vec<index_fence> fence;
+        build_index_pages(h.offset_table, &pages, &fence);
+        writer->write_u64(fence.size());
+        for (const auto& f : fence) {
+            writer->write_u64(f.first);
+            writer->write_u32(f.crc);
+        }
+    } else {
+        for (const auto& [entry_id, offset] : h.offset_table) {
+            writer->write_u64(entry_id);
+            writer->write_u64(offset);
+        }
+    }
+
+    if (!superblock) {
+        writer->write_u64(h.user_section_size);
+        if (h.user_section_size > 0) {
+            writer->write_bytes(h.user_section);
+        }
+    }
+
+    if (h.flags & KRES_FLAG_SOLID) {
+        writer->write_u64(h.block_table.size());
+        for (const auto& block : h.block_table) {
+            writer->write_u64(block.offset);
+            writer->write_u64(block.size);
+        }
+    }
+
+    if (h.flags & KRES_FLAG_ID_FILTER) {
+        writer->write_u64(h.id_filter.size());
+        for (const auto& block : h.id_filter) {
+            for (uint32_t word : block.words) writer->write_u32(word);
+        }
+    }
+
+    if (h.flags & KRES_FLAG_VOLUMES) {
+        writer->write_u64(h.volume_size_cap);
+        writer->write_u64(h.volume_sizes.size());
+        for (uint64_t size : h.volume_sizes) writer->write_u64(size);
+    }
+
+    if (h.flags & KRES_FLAG_SOURCE_META) {
+        writer->write_u64(h.source_meta.size());
+        for (const auto& meta : h.source_meta) {
+            writer->write_u64(meta.entry_id);
+            writer->write_u64(static_cast<uint64_t>(meta.mtime));
+            writer->write_u64(meta.size);
+        }
+    }
+
+    if (h.flags & KRES_FLAG_ATTRIBUTES) {
+        writer->write_u64(h.attribute_columns.size());
+        for (const auto& column : h.attribute_columns) {
+            writer->write_u32(column.type);
+            writer->write_u32(static_cast<uint32_t>(column.name.size()));
+            writer->write_raw(column.name.data(), column.name.size());
+        }
+        writer->write_u32(h.attribute_crc);
+    }
+
+    if (superblock) {
+        writer->write_u64(h.user_section_size);
+
+        std::byte* index = writer->buffer->data() + start;
+        uint32_t crc = host_to_le32(header_crc(index, writer->buffer->size() - start));
+        std::memcpy(index + KRES_SUPERBLOCK_SIZE - 4, &crc, 4);
+
+        if (h.user_section_size > 0) writer->write_bytes(h.user_section);
+
+        if (h.flags & KRES_FLAG_GENERATIONS) {
+            // only the slots of generation 0 are ever read, later indexes leave theirs empty
+            std::byte root[2 * KRES_ROOT_SLOT_SIZE] = {};
+            if (h.index_offset == 0) encode_root_slot(root_slot{0, 0, index_size(h)}, root);
+            writer->write_raw(root, sizeof(root));
+        }
+
+        if (!pages.empty()) {
+            writer->buffer->resize(start + index_pages_offset(h), std::byte{0});
+            writer->write_bytes(pages);
+        }
+
+        if (h.flags & KRES_FLAG_ATTRIBUTES) {
+            writer->buffer->resize(start + attribute_section_offset(h), std::byte{0});
+            writer->write_bytes(h.attribute_section);
+            writer->buffer->resize(start + header_size(h), std::byte{0});
+        }
+    }
+}
+
+// where make_header and the serializers put records, shared so the two can't disagree
+//
+// solid archives lay regular records out first and then the small ones back to back, cut into
+// blocks of about solid_block_size bytes, everything else is written in entry order, split archives
+// then cut that sequence into volumes, never inside a block
+struct record_layout {
+    vec<size_t> order;                 // entry indices in file order
+    vec<pair<size_t, size_t>> blocks;  // (first position in order, count) per solid block
+    vec<size_t> volume_starts;         // first position in order of every record volume
+};
+
+static record_layout plan_records(const archive& ar) {
+    const header& h = ar.header;
+    record_layout out;
+    out.order.resize(ar.entries.size());
+
+    if (!(h.flags & KRES_FLAG_SOLID)) {
+        for (size_t i = 0; i < out.order.size(); i++) out.order[i] = i;
+    } else {
+        size_t pos = 0;
+        for (size_t i = 0; i < ar.entries.size(); i++) {
+            if (ar.entries[i].size > h.solid_entry_limit) out.order[pos++] = i;
+        }
+
+        uint64_t block_bytes = 0;
+        for (size_t i = 0; i < ar.entries.size(); i++) {
+            if (ar.entries[i].size > h.solid_entry_limit) continue;
+            if (out.blocks.empty() || block_bytes >= h.solid_block_size) {
+                out.blocks.emplace_back(pos, 0);
+                block_bytes = 0;
+            }
+            out.blocks.back().second++;
+            block_bytes += record_size(ar.entries[i]);
+            out.order[pos++] = i;
+        }
+    }
+
+    if (h.flags & KRES_FLAG_VOLUMES) {
+        uint64_t cap = h.volume_size_cap == 0 ? UINT64_MAX : h.volume_size_cap;
+        uint64_t used = 0;
+        size_t next_block = 0;
+        for (size_t pos = 0; pos < out.order.size();) {
+            size_t count = 1;
+            if (next_block < out.blocks.size() && out.blocks[next_block].first == pos) {
+                count = out.blocks[next_block++].second;
+            }
+
+            uint64_t bytes = 0;
+            for (size_t i = pos; i < pos + count; i++) {
+                bytes += record_size(ar.entries[out.order[i]]);
+            }
+
+            // anything bigger than the cap simply gets a volume of its own
+            if (out.volume_starts.empty() || (used > 0 && (used >= cap || bytes > cap - used))) {
+                out.volume_starts.push_back(pos);
+                used = 0;
+            }
+            used += bytes;
+            pos += count;
+        }
+    }
+
+    return out;
+}
+
+// everything in a record except the payload, crc is passed separately since generated entries only
+// know it once their payload exists
+static void write_record_prefix(byte_writer* writer, const entry& e, uint32_t crc) {
+    writer->write_u32(e.filename_len);
+    writer->write_string(e.filename);
+    writer->write_u32(crc);
+    writer->write_u64(e.size);
+}
+
+// owned or borrowed payload, deferred ones are handled by the serializers themselves
+static std::span<const std::byte> entry_payload(const entry& e) {
+    if (!e.view.empty()) return e.view;
+    return e.data;
+}
+
+static bool is_deferred(const entry& e) { return e.source || !e.source_path.empty(); }
+
+// produces the payload of a deferred entry into out, which is exactly e.size bytes
+static kres_err fill_payload(const entry& e, std::span<std::byte> out) {
+    if (e.source) return e.source(out);
+
+    file_reader r;
+    auto err = r.open(e.source_path.c_str());
+    if (err != KRES_OK) return KRES_ERROR_INVALID_INPUT_FILE;
+    err = r.seek(e.source_offset);
+    if (err != KRES_OK) return err;
+    return r.read_into(out.data(), out.size());
+}
+
+// reads a record carried over from another archive into out, which is exactly record_size(e) bytes
+static kres_err fill_record(const entry& e, std::span<std::byte> out) {
+    file_reader r;
+    auto err = r.open(e.source_path.c_str());
+    if (err != KRES_OK) return KRES_ERROR_INVALID_INPUT_FILE;
+    err = r.seek(e.source_offset);
+    if (err != KRES_OK) return err;
+    return r.read_into(out.data(), out.size());
+}
+
 kres_err serialize_archive(const archive& arch, byte_vec* out) {
+    if (arch.header.flags & KRES_FLAG_VOLUMES) return KRES_INVALID_STATE;  // needs several files
+
+    trace_scope trace("serialize", arch.entries.size());
+    out->reserve(out->size() + serialized_size(arch));
+
     byte_writer writer;
     writer.buffer = out;
 
-    writer.write_u32(arch.header.magic);
-    writer.write_u32(arch.header.version);
-    writer.write_u32(arch.header.flags);
-    writer.write_u64(arch.header.entry_count);
+    write_header(&writer, arch.header);
+    for (size_t i : plan_records(arch).order) {
+        const auto& entry = arch.entries[i];
+        if (!is_deferred(entry)) {
+            auto payload = entry_payload(entry);
+            write_record_prefix(&writer, entry, entry.crc32);
+            writer.write_raw(payload.data(), payload.size());
+            continue;
+        }
+        if (entry.source_record) {
+            size_t start = out->size();
+            out->resize(start + record_size(entry));
+            auto err = fill_record(entry, std::span(out->data() + start, out->size() - start));
+            if (err != KRES_OK) return err;
+            continue;
+        }
+
+        // generated straight into the output, the crc is patched in afterwards
+        write_record_prefix(&writer, entry, 0);
+        size_t crc_pos = out->size() - 8 - 4;
+        size_t start = out->size();
+        out->resize(start + entry.size);
+
+        auto err = fill_payload(entry, std::span<std::byte>(out->data() + start, entry.size));
+        if (err != KRES_OK) return err;
+
+        uint32_t crc = host_to_le32(crc32(out->data() + start, entry.size));
+        std::memcpy(out->data() + crc_pos, &crc, 4);
+    }
+
+    return KRES_OK;
+}
+
+#ifdef _WIN32
+// writes the records at positions [begin, end) of order to the current position of file
+static kres_err write_records(std::ofstream& file,
+                              const archive& arch,
+                              const vec<size_t>& order,
+                              size_t begin,
+                              size_t end) {
+    byte_writer writer;
+    byte_vec prefix;
+    byte_vec generated;
+    for (size_t pos = begin; pos < end; pos++) {
+        const auto& entry = arch.entries[order[pos]];
+        if (entry.source_record) {
+            generated.resize(record_size(entry));
+            auto err = fill_record(entry, generated);
+            if (err != KRES_OK) return err;
+            file.write(reinterpret_cast<const char*>(generated.data()), generated.size());
+            continue;
+        }
+
+        auto payload = entry_payload(entry);
+        uint32_t crc = entry.crc32;
+        if (is_deferred(entry)) {
+            generated.resize(entry.size);
+            auto err = fill_payload(entry, generated);
+            if (err != KRES_OK) return err;
+            payload = generated;
+            crc = crc32(generated.data(), generated.size());
+        }
+
+        prefix.clear();
+        writer.buffer = &prefix;
+        write_record_prefix(&writer, entry, crc);
+        file.write(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+        file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    }
+
+    return file.good() ? KRES_OK : KRES_ERROR_FAILED_IO;
+}
+#else
+// streams a file backed entry into fd in chunks, each chunk is checksummed straight from a read
+// only mapping of the source and then copied by the kernel (linux), so it never lands in a user
+// buffer, at is where the payload goes in fd, UINT64_MAX for the current position
+static kres_err copy_file_entry(int fd, const entry& e, uint64_t at, uint32_t* crc_out) {
+    int src = ::open(e.source_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return KRES_ERROR_INVALID_INPUT_FILE;
+
+    struct stat st {};
+    if (::fstat(src, &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) < e.source_offset + e.size) {
+        ::close(src);
+        return KRES_ERROR_INVALID_INPUT_FILE;  // changed since it was added
+    }
+
+    constexpr uint64_t chunk = 8 * 1024 * 1024;
+    static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint32_t crc = 0;
+    kres_err err = KRES_OK;
+
+    for (uint64_t done = 0; done < e.size && err == KRES_OK;) {
+        uint64_t offset = e.source_offset + done;
+        uint64_t len = std::min(chunk, e.size - done);
+        uint64_t aligned = offset & ~(page - 1);
+
+        void* m = ::mmap(nullptr, len + (offset - aligned), PROT_READ, MAP_PRIVATE, src,
+                         static_cast<off_t>(aligned));
+        if (m == MAP_FAILED) {
+            err = KRES_ERROR_FAILED_IO;
+            break;
+        }
+        crc = crc32_update(crc, static_cast<const std::byte*>(m) + (offset - aligned), len);
+        ::munmap(m, len + (offset - aligned));
+
+#ifdef __linux__
+        err = at == UINT64_MAX ? copy_range(src, fd, offset, len)
+                               : copy_range_at(src, fd, offset, at + done, len);
+#else
+        byte_vec buf(len);
+        ssize_t n = ::pread(src, buf.data(), len, static_cast<off_t>(offset));
+        if (n != static_cast<ssize_t>(len)) {
+            err = KRES_ERROR_FAILED_IO;
+            break;
+        }
+        iovec buf_iov{buf.data(), buf.size()};
+        err = at == UINT64_MAX ? write_all(fd, &buf_iov, 1)
+                               : pwrite_all(fd, buf.data(), len, at + done);
+#endif
+        done += len;
+    }
+
+    ::close(src);
+    *crc_out = crc;
+    return err;
+}
 
-    for (const auto& [entry_id, offset] : arch.header.offset_table) {
-        writer.write_u64(entry_id);
-        writer.write_u64(offset);
+// copies records carried over from another archive, the one at *pos and as many after it (up to
+// end) as sit right behind each other in the same source file, with one range copy to at in fd
+// (UINT64_MAX for the current position), *pos and *bytes are advanced past the run
+static kres_err copy_record_run(int fd,
+                                const archive& arch,
+                                const vec<size_t>& order,
+                                size_t* pos,
+                                size_t end,
+                                uint64_t at,
+                                uint64_t* bytes) {
+    const entry& first = arch.entries[order[*pos]];
+    uint64_t len = record_size(first);
+    size_t next = *pos + 1;
+    for (; next < end; next++) {
+        const entry& e = arch.entries[order[next]];
+        if (!e.source_record || e.source_path != first.source_path ||
+            e.source_offset != first.source_offset + len) {
+            break;
+        }
+        len += record_size(e);
     }
 
-    writer.write_u64(arch.header.user_section_size);
-    if (arch.header.user_section_size > 0) {
-        writer.write_bytes(arch.header.user_section);
+    int src = ::open(first.source_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (src < 0) return KRES_ERROR_INVALID_INPUT_FILE;
+
+#ifdef __linux__
+    auto err = at == UINT64_MAX ? copy_range(src, fd, first.source_offset, len)
+                                : copy_range_at(src, fd, first.source_offset, at, len);
+#else
+    kres_err err = KRES_OK;
+    byte_vec buf(std::min<uint64_t>(len, 8 * 1024 * 1024));
+    for (uint64_t done = 0; done < len && err == KRES_OK;) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(len - done, buf.size()));
+        err = pread_all(src, buf.data(), chunk, first.source_offset + done);
+        if (err != KRES_OK) break;
+        iovec buf_iov{buf.data(), chunk};
+        err = at == UINT64_MAX ? write_all(fd, &buf_iov, 1)
+                               : pwrite_all(fd, buf.data(), chunk, at + done);
+        done += chunk;
     }
+#endif
+
+    ::close(src);
+    if (err == KRES_ERROR_EOF) err = KRES_ERROR_INVALID_INPUT_FILE;  // source shrank
+    *pos = next;
+    *bytes += len;
+    return err;
+}
 
-    for (const auto& entry : arch.entries) {
-        writer.write_u32(entry.filename_len);
-        writer.write_string(entry.filename);
-        writer.write_u32(entry.crc32);
-        writer.write_u64(entry.size);
-        writer.write_bytes(entry.data);
+// writes the records at positions [begin, end) of order to the current position of fd
+static kres_err write_records(int fd,
+                              const archive& arch,
+                              const vec<size_t>& order,
+                              size_t begin,
+                              size_t end) {
+    // records go out in batches, two iovecs each (prefix + payload straight from the entry), the
+    // prefixes of a batch share one buffer sized before any pointer into it is taken
+    constexpr size_t batch_entries = IOV_MAX / 2;
+    vec<iovec> iov;
+    iov.reserve(batch_entries * 2);
+    byte_vec prefixes;
+    byte_vec generated;
+    byte_writer writer;
+
+    kres_err err = KRES_OK;
+
+    for (size_t first = begin; first < end && err == KRES_OK; first += batch_entries) {
+        size_t last = std::min(first + batch_entries, end);
+
+        size_t prefix_bytes = 0;
+        for (size_t i = first; i < last; i++) {
+            const entry& e = arch.entries[order[i]];
+            prefix_bytes += record_size(e) - e.size;
+        }
+        prefixes.clear();
+        prefixes.reserve(prefix_bytes);
+        writer.buffer = &prefixes;
+
+        for (size_t i = first; i < last && err == KRES_OK; i++) {
+            const entry& e = arch.entries[order[i]];
+            size_t start = prefixes.size();
+
+            if (!is_deferred(e)) {
+                auto payload = entry_payload(e);
+                write_record_prefix(&writer, e, e.crc32);
+                iov.push_back({prefixes.data() + start, prefixes.size() - start});
+                if (!payload.empty()) {
+                    iov.push_back({const_cast<std::byte*>(payload.data()), payload.size()});
+                }
+                continue;
+            }
+
+            // deferred payloads go out on their own, so flush what's queued first
+            err = write_all(fd, iov.data(), static_cast<int>(iov.size()));
+            iov.clear();
+            if (err != KRES_OK) break;
+
+            if (e.source_record) {
+                size_t next = i;
+                uint64_t bytes = 0;
+                err = copy_record_run(fd, arch, order, &next, last, UINT64_MAX, &bytes);
+                i = next - 1;
+                continue;
+            }
+
+            if (!e.source_path.empty()) {
+                write_record_prefix(&writer, e, 0);
+                iovec prefix_iov{prefixes.data() + start, prefixes.size() - start};
+                err = write_all(fd, &prefix_iov, 1);
+                if (err != KRES_OK) break;
+
+                uint32_t crc = 0;
+                err = copy_file_entry(fd, e, UINT64_MAX, &crc);
+                if (err != KRES_OK) break;
+
+                // the crc sits right before the u64 size at the end of the prefix
+                off_t pos = ::lseek(fd, 0, SEEK_CUR);
+                if (pos < 0) {
+                    err = KRES_ERROR_FAILED_IO;
+                    break;
+                }
+                crc = host_to_le32(crc);
+                err = pwrite_all(fd, &crc, 4, static_cast<uint64_t>(pos) - e.size - 8 - 4);
+                continue;
+            }
+
+            generated.resize(e.size);
+            err = e.source(generated);
+            if (err != KRES_OK) break;
+
+            write_record_prefix(&writer, e, crc32(generated.data(), generated.size()));
+            iov.push_back({prefixes.data() + start, prefixes.size() - start});
+            iov.push_back({generated.data(), generated.size()});
+            err = write_all(fd, iov.data(), static_cast<int>(iov.size()));
+            iov.clear();
+        }
+
+        if (err == KRES_OK) err = write_all(fd, iov.data(), static_cast<int>(iov.size()));
+        iov.clear();
+    }
+
+    return err;
+}
+
+// write_records with positional writes only, the records at positions [begin, end) of order go to
+// offset in fd and any number of these can run on the same fd at once
+static kres_err pwrite_records(int fd,
+                               const archive& arch,
+                               const vec<size_t>& order,
+                               size_t begin,
+                               size_t end,
+                               uint64_t offset) {
+    constexpr size_t batch_entries = IOV_MAX / 2;
+    vec<iovec> iov;
+    iov.reserve(batch_entries * 2);
+    byte_vec prefixes;
+    byte_vec generated;
+    byte_writer writer;
+
+    kres_err err = KRES_OK;
+    uint64_t queued_at = offset;  // where the queued iovecs start
+
+    for (size_t first = begin; first < end && err == KRES_OK; first += batch_entries) {
+        size_t last = std::min(first + batch_entries, end);
+
+        size_t prefix_bytes = 0;
+        for (size_t i = first; i < last; i++) {
+            const entry& e = arch.entries[order[i]];
+            prefix_bytes += record_size(e) - e.size;
+        }
+        prefixes.clear();
+        prefixes.reserve(prefix_bytes);
+        writer.buffer = &prefixes;
+
+        for (size_t i = first; i < last && err == KRES_OK; i++) {
+            const entry& e = arch.entries[order[i]];
+            size_t start = prefixes.size();
+            uint64_t prefix_size = record_size(e) - e.size;
+
+            if (!is_deferred(e)) {
+                auto payload = entry_payload(e);
+                write_record_prefix(&writer, e, e.crc32);
+                iov.push_back({prefixes.data() + start, prefixes.size() - start});
+                if (!payload.empty()) {
+                    iov.push_back({const_cast<std::byte*>(payload.data()), payload.size()});
+                }
+                offset += record_size(e);
+                continue;
+            }
+
+            err = pwritev_all(fd, iov.data(), static_cast<int>(iov.size()), queued_at);
+            iov.clear();
+            if (err != KRES_OK) break;
+
+            if (e.source_record) {
+                size_t next = i;
+                uint64_t bytes = 0;
+                err = copy_record_run(fd, arch, order, &next, last, offset, &bytes);
+                i = next - 1;
+                offset += bytes;
+                queued_at = offset;
+                continue;
+            }
+
+            // the payload goes first here, so the prefix is written once with its final crc
+            uint32_t crc = 0;
+            if (!e.source_path.empty()) {
+                err = copy_file_entry(fd, e, offset + prefix_size, &crc);
+                if (err != KRES_OK) break;
+            } else {
+                generated.resize(e.size);
+                err = e.source(generated);
+                if (err != KRES_OK) break;
+                crc = crc32(generated.data(), generated.size());
+                err = pwrite_all(fd, generated.data(), generated.size(), offset + prefix_size);
+                if (err != KRES_OK) break;
+            }
+
+            write_record_prefix(&writer, e, crc);
+            err = pwrite_all(fd, prefixes.data() + start, prefixes.size() - start, offset);
+            offset += record_size(e);
+            queued_at = offset;
+        }
+
+        if (err == KRES_OK) {
+            err = pwritev_all(fd, iov.data(), static_cast<int>(iov.size()), queued_at);
+        }
+        iov.clear();
+        queued_at = offset;
+    }
+
+    return err;
+}
+#endif
+
+// split archives get the index alone in filename, the records of volume v go to its own file
+static vec<pair<string, pair<size_t, size_t>>> record_files(const record_layout& layout,
+                                                            const string& filename) {
+    vec<pair<string, pair<size_t, size_t>>> files;  // path, [first, last) positions in the order
+    if (!layout.volume_starts.empty()) {
+        files.push_back({filename, {0, 0}});
+        for (size_t v = 0; v < layout.volume_starts.size(); v++) {
+            size_t last = v + 1 < layout.volume_starts.size() ? layout.volume_starts[v + 1]
+                                                              : layout.order.size();
+            files.push_back({volume_path(filename, v + 1), {layout.volume_starts[v], last}});
+        }
+    } else {
+        files.push_back({filename, {0, layout.order.size()}});
+    }
+    return files;
+}
+
+kres_err serialize_archive(const archive& arch, const string& filename) {
+    trace_scope trace("write", serialized_size(arch));
+
+    byte_vec head;
+    byte_writer writer;
+    writer.buffer = &head;
+    head.reserve(header_size(arch.header));
+    write_header(&writer, arch.header);
+
+    record_layout layout = plan_records(arch);
+    auto files = record_files(layout, filename);
+
+    for (size_t f = 0; f < files.size(); f++) {
+        const auto& [path, range] = files[f];
+#ifdef _WIN32
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return KRES_ERROR_FAILED_IO;
+
+        if (f == 0) file.write(reinterpret_cast<const char*>(head.data()), head.size());
+        auto err = write_records(file, arch, layout.order, range.first, range.second);
+        if (err != KRES_OK) return err;
+#else
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return KRES_ERROR_FAILED_IO;
+
+        kres_err err = KRES_OK;
+        if (f == 0) {
+            iovec head_iov{head.data(), head.size()};
+            err = write_all(fd, &head_iov, 1);
+        }
+        if (err == KRES_OK) err = write_records(fd, arch, layout.order, range.first, range.second);
+
+        if (::close(fd) != 0 && err == KRES_OK) err = KRES_ERROR_FAILED_IO;
+        if (err != KRES_OK) return err;
+#endif
     }
 
     return KRES_OK;
 }
 
-kres_err parse_header(const byte_vec& data, header* h) {
+kres_err serialize_archive_parallel(const archive& arch, const string& filename, uint32_t threads) {
+#ifdef _WIN32
+    (void)threads;
+    return serialize_archive(arch, filename);
+#else
+    trace_scope trace("write", serialized_size(arch));
+
+    byte_vec head;
+    byte_writer writer;
+    writer.buffer = &head;
+    head.reserve(header_size(arch.header));
+    write_header(&writer, arch.header);
+
+    record_layout layout = plan_records(arch);
+    auto files = record_files(layout, filename);
+
+    // every record's offset is known up front, so the files are cut into runs of about job_bytes
+    // and the runs are written by whichever worker picks them up
+    struct write_job {
+        size_t file;
+        size_t begin, end;  // positions in the order
+        uint64_t offset;    // of the first record in its file
+    };
+    constexpr uint64_t job_bytes = 4 * 1024 * 1024;
+    vec<write_job> jobs;
+    vec<uint64_t> sizes(files.size());
+    for (size_t f = 0; f < files.size(); f++) {
+        const auto& [first, last] = files[f].second;
+        uint64_t offset = f == 0 ? head.size() : 0;
+        uint64_t run = 0;
+        for (size_t pos = first; pos < last; pos++) {
+            if (pos == first || run >= job_bytes) {
+                jobs.push_back({f, pos, pos, offset});
+                run = 0;
+            }
+            uint64_t bytes = record_size(arch.entries[layout.order[pos]]);
+            jobs.back().end = pos + 1;
+            offset += bytes;
+            run += bytes;
+        }
+        sizes[f] = f == 0 ? std::max<uint64_t>(offset, head.size()) : offset;
+    }
+
+    // the final sizes are allocated before anything is written, so the workers never extend files
+    vec<int> fds;
+    auto close_all = [&fds] {
+        kres_err err = KRES_OK;
+        for (int fd : fds) {
+            if (::close(fd) != 0) err = KRES_ERROR_FAILED_IO;
+        }
+        return err;
+    };
+    for (size_t f = 0; f < files.size(); f++) {
+        int fd = ::open(files[f].first.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            close_all();
+            return KRES_ERROR_FAILED_IO;
+        }
+        fds.push_back(fd);
+
+        auto size = static_cast<off_t>(sizes[f]);
+#ifdef __linux__
+        bool allocated = size == 0 || ::fallocate(fd, 0, 0, size) == 0;
+#else
+        bool allocated = false;
+#endif
+        if (!allocated && ::ftruncate(fd, size) != 0) {
+            close_all();
+            return KRES_ERROR_FAILED_IO;
+        }
+    }
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<uint32_t>(std::min<size_t>(threads, std::max<size_t>(jobs.size(), 1)));
+
+    std::atomic<size_t> next{0};
+    std::atomic<int> first_error{KRES_OK};
+    auto worker = [&] {
+        while (first_error.load(std::memory_order_relaxed) == KRES_OK) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= jobs.size()) return;
+
+            const write_job& job = jobs[i];
+            auto job_err = pwrite_records(fds[job.file], arch, layout.order, job.begin, job.end,
+                                          job.offset);
+            if (job_err != KRES_OK) {
+                int expected = KRES_OK;
+                first_error.compare_exchange_strong(expected, job_err);
+            }
+        }
+    };
+
+    vec<std::thread> pool;
+    for (uint32_t t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+
+    // the header goes last, a file cut short by a crash never looks like a complete archive
+    auto err = static_cast<kres_err>(first_error.load());
+    if (err == KRES_OK) err = pwrite_all(fds[0], head.data(), head.size(), 0);
+    kres_err close_err = close_all();
+    return err != KRES_OK ? err : close_err;
+#endif
+}
+
+kres_err write_records_at(const string& filename, const archive& arch, uint64_t offset) {
+    vec<size_t> order(arch.entries.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+
+#ifdef _WIN32
+    std::ofstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) return KRES_ERROR_FAILED_IO;
+    file.seekp(static_cast<std::streamoff>(offset));
+    auto err = write_records(file, arch, order, 0, order.size());
+    file.close();
+    return err == KRES_OK && file.fail() ? KRES_ERROR_FAILED_IO : err;
+#else
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return KRES_ERROR_FAILED_IO;
+    auto err = pwrite_records(fd, arch, order, 0, order.size(), offset);
+    if (::close(fd) != 0 && err == KRES_OK) err = KRES_ERROR_FAILED_IO;
+    return err;
+#endif
+}
+
+kres_err parse_index(const byte_vec& data, header* h, bool user_data) {
     byte_reader reader;
     reader.buffer = &data;
     reader.pos = 0;
@@ -79,30 +890,192 @@ kres_err parse_header(const byte_vec& data, header* h) {
     if (err != KRES_OK) return err;
     err = reader.read_u32(&h->flags);
     if (err != KRES_OK) return err;
+    if (h->flags & ~KRES_FLAGS_KNOWN) return KRES_ERROR_MISMATCHED_VERSION;  // a newer layout
     err = reader.read_u64(&h->entry_count);
     if (err != KRES_OK) return err;
 
-    h->offset_table.reserve(h->entry_count);
-    for (uint64_t i = 0; i < h->entry_count; i++) {
-        id entry_id;
-        uint64_t offset;
-        err = reader.read_u64(&entry_id);
+    bool superblock = h->flags & KRES_FLAG_SUPERBLOCK;
+    bool paged = h->flags & KRES_FLAG_PAGED_INDEX;
+    uint64_t total_size = 0;
+    uint64_t index = 0;
+    if (superblock) {
+        uint32_t crc;
+        err = reader.read_u64(&total_size);
+        if (err != KRES_OK) return err;
+        err = reader.read_u64(&index);
         if (err != KRES_OK) return err;
-        err = reader.read_u64(&offset);
+        err = reader.read_u32(&crc);
         if (err != KRES_OK) return err;
-        h->offset_table[entry_id] = offset;
+
+        if (index < KRES_SUPERBLOCK_SIZE + 8 || index > data.size() || total_size < index) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        // offset table rows, or fence rows of a paged index, have to fit into the index
+        uint64_t rows = paged ? h->entry_count / KRES_INDEX_PAGE_ENTRIES : h->entry_count;
+        if (rows > (index - KRES_SUPERBLOCK_SIZE) / (paged ? 12 : 16)) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        if (header_crc(data.data(), index) != crc) return KRES_ERROR_INVALID_ARCHIVE;
+    } else if (h->flags & (KRES_FLAG_PAGED_INDEX | KRES_FLAG_GENERATIONS)) {
+        return KRES_ERROR_INVALID_ARCHIVE;  // both are only ever written behind a superblock
+    }
+
+    if (paged) {
+        uint64_t page_count;
+        err = reader.read_u64(&page_count);
+        if (err != KRES_OK) return err;
+        if (page_count != index_page_count(h->entry_count)) return KRES_ERROR_INVALID_ARCHIVE;
+        h->page_fence.resize(page_count);
+        for (auto& f : h->page_fence) {
+            err = reader.read_u64(&f.first);
+            if (err != KRES_OK) return err;
+            err = reader.read_u32(&f.crc);
+            if (err != KRES_OK) return err;
+        }
+    } else {
+        h->offset_table.reserve(h->entry_count);
+        for (uint64_t i = 0; i < h->entry_count; i++) {
+            id entry_id;
+            uint64_t offset;
+            err = reader.read_u64(&entry_id);
+            if (err != KRES_OK) return err;
+            err = reader.read_u64(&offset);
+            if (err != KRES_OK) return err;
+            h->offset_table[entry_id] = offset;
+        }
+    }
+
+    if (!superblock) {
+        err = reader.read_u64(&h->user_section_size);
+        if (err != KRES_OK) return err;
+
+        h->user_section_offset = reader.tell();
+        if (h->user_section_size > 0) {
+            err = reader.read_bytes(h->user_section_size, &h->user_section);
+            if (err != KRES_OK) return err;
+        }
     }
-    err = reader.read_u64(&h->user_section_size);
-    if (err != KRES_OK) return err;
 
-    if (h->user_section_size > 0) {
-        err = reader.read_bytes(h->user_section_size, &h->user_section);
+    if (h->flags & KRES_FLAG_SOLID) {
+        uint64_t block_count;
+        err = reader.read_u64(&block_count);
+        if (err != KRES_OK) return err;
+        if (block_count > h->entry_count) return KRES_ERROR_INVALID_ARCHIVE;
+        h->block_table.resize(block_count);
+        for (auto& block : h->block_table) {
+            err = reader.read_u64(&block.offset);
+            if (err != KRES_OK) return err;
+            err = reader.read_u64(&block.size);
+            if (err != KRES_OK) return err;
+        }
+    }
+
+    if (h->flags & KRES_FLAG_ID_FILTER) {
+        uint64_t block_count;
+        err = reader.read_u64(&block_count);
+        if (err != KRES_OK) return err;
+        if (block_count != filter_block_count(h->entry_count)) return KRES_ERROR_INVALID_ARCHIVE;
+        h->id_filter.resize(block_count);
+        for (auto& block : h->id_filter) {
+            for (uint32_t& word : block.words) {
+                err = reader.read_u32(&word);
+                if (err != KRES_OK) return err;
+            }
+        }
+    }
+
+    if (h->flags & KRES_FLAG_VOLUMES) {
+        uint64_t volume_count;
+        err = reader.read_u64(&h->volume_size_cap);
+        if (err != KRES_OK) return err;
+        err = reader.read_u64(&volume_count);
+        if (err != KRES_OK) return err;
+        if (volume_count == 0 || volume_count > h->entry_count + 1) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        h->volume_sizes.resize(volume_count);
+        for (uint64_t& size : h->volume_sizes) {
+            err = reader.read_u64(&size);
+            if (err != KRES_OK) return err;
+        }
+    }
+
+    // only located, build_cache.h reads the rows when it needs them
+    if (h->flags & KRES_FLAG_SOURCE_META) {
+        err = reader.read_u64(&h->source_meta_count);
+        if (err != KRES_OK) return err;
+        if (h->source_meta_count > h->entry_count) return KRES_ERROR_INVALID_ARCHIVE;
+        h->source_meta_offset = reader.tell();
+        if (h->source_meta_offset + h->source_meta_count * 24 > data.size()) {
+            return KRES_ERROR_BUFFER_OVERFLOW;
+        }
+        reader.seek(h->source_meta_offset + h->source_meta_count * 24);
+    }
+
+    // just the column names, the columns themselves are left to load_attributes
+    if (h->flags & KRES_FLAG_ATTRIBUTES) {
+        if (!superblock) return KRES_ERROR_INVALID_ARCHIVE;
+        uint64_t column_count;
+        err = reader.read_u64(&column_count);
+        if (err != KRES_OK) return err;
+        if (column_count > (data.size() - reader.tell()) / 8) return KRES_ERROR_INVALID_ARCHIVE;
+        h->attribute_columns.resize(column_count);
+        for (auto& column : h->attribute_columns) {
+            uint32_t name_len;
+            err = reader.read_u32(&column.type);
+            if (err != KRES_OK) return err;
+            if (column.type != KRES_ATTR_U32 && column.type != KRES_ATTR_U64) {
+                return KRES_ERROR_INVALID_ARCHIVE;
+            }
+            err = reader.read_u32(&name_len);
+            if (err != KRES_OK) return err;
+            byte_vec name;
+            err = reader.read_bytes(name_len, &name);
+            if (err != KRES_OK) return err;
+            column.name.assign(reinterpret_cast<const char*>(name.data()), name.size());
+        }
+        err = reader.read_u32(&h->attribute_crc);
         if (err != KRES_OK) return err;
     }
 
+    if (superblock) {
+        err = reader.read_u64(&h->user_section_size);
+        if (err != KRES_OK) return err;
+        if (reader.tell() != index || total_size != header_size(*h)) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+
+        h->user_section_offset = index;
+        if (h->flags & KRES_FLAG_GENERATIONS) h->root_offset = index + h->user_section_size;
+        if (user_data && h->user_section_size > 0) {
+            err = reader.read_bytes(h->user_section_size, &h->user_section);
+            if (err != KRES_OK) return err;
+        }
+
+        // the whole header is in data, so the pages can be taken in as well
+        if (paged && user_data && data.size() >= total_size) {
+            const std::byte* pages = data.data() + index_pages_offset(*h);
+            h->offset_table.reserve(h->entry_count);
+            for (uint64_t p = 0; p < h->page_fence.size(); p++) {
+                const std::byte* page = pages + p * KRES_INDEX_PAGE_SIZE;
+                if (crc32(page, KRES_INDEX_PAGE_SIZE) != h->page_fence[p].crc) {
+                    return KRES_ERROR_INVALID_ARCHIVE;
+                }
+                uint64_t count = std::min(KRES_INDEX_PAGE_ENTRIES,
+                                          h->entry_count - p * KRES_INDEX_PAGE_ENTRIES);
+                decode_index_page(page, count, &h->offset_table);
+            }
+        }
+    }
+
     return KRES_OK;
 }
 
+kres_err parse_header(const byte_vec& data, header* h) {
+    trace_scope trace("header_parse");
+    return parse_index(data, h, true);
+}
+
 kres_err extract_entry_by_id(const byte_vec& data, const header& h, id entry_id, entry* out) {
     auto it = h.offset_table.find(entry_id);
     if (it == h.offset_table.end()) {
@@ -134,9 +1107,10 @@ kres_err extract_entry_by_id(const byte_vec& data, const header& h, id entry_id,
     return KRES_OK;
 }
 
-kres_err build_archive(const vec<entry>& entries, archive* out, const byte_vec* user_data) {
-    out->entries = entries;
-    out->header.entry_count = entries.size();
+// both build_archive overloads, kept out of the deprecated api so neither calls into it
+static kres_err build_owned_archive(vec<entry>&& entries, archive* out, const byte_vec* user_data) {
+    out->entries = std::move(entries);
+    out->header.entry_count = out->entries.size();
 
     if (user_data) {
         out->header.user_section = *user_data;
@@ -145,26 +1119,33 @@ kres_err build_archive(const vec<entry>& entries, archive* out, const byte_vec*
         out->header.user_section_size = 0;
     }
 
-    size_t header_size = 4 + 4 + 4 + 8;                // magic, version, flags, entry_count
-    header_size += entries.size() * 16;                // offset table (id + offset per entry)
-    header_size += 8 + out->header.user_section_size;  // user section size + data
-
-    uint64_t current_offset = header_size;
+    uint64_t current_offset = header_size(out->header);
 
-    out->header.offset_table.reserve(entries.size());
-    out->header.filename_table.reserve(entries.size());
+    {
+        trace_scope trace("index_build", out->entries.size());
+        out->header.offset_table.reserve(out->entries.size());
+        out->header.filename_table.reserve(out->entries.size());
 
-    for (const auto& entry : entries) {
-        id entry_id = generate_id(entry.filename);
-        out->header.offset_table[entry_id] = current_offset;
-        out->header.filename_table[entry_id] = entry.filename;
+        for (const auto& entry : out->entries) {
+            id entry_id = generate_id(entry.filename);
+            out->header.offset_table[entry_id] = current_offset;
+            out->header.filename_table[entry_id] = entry.filename;
 
-        current_offset += 4 + entry.filename.length() + 1 + 4 + 8 + entry.size;
+            current_offset += record_size(entry);
+        }
     }
 
     return serialize_archive(*out, &out->raw_data);
 }
 
+kres_err build_archive(const vec<entry>& entries, archive* out, const byte_vec* user_data) {
+    return build_owned_archive(vec<entry>(entries), out, user_data);
+}
+
+kres_err build_archive(vec<entry>&& entries, archive* out, const byte_vec* user_data) {
+    return build_owned_archive(std::move(entries), out, user_data);
+}
+
 kres_err extract_entry_by_name(const byte_vec& data,
                                const header& h,
                                const string& filename,
@@ -199,81 +1180,219 @@ archive init_archive() { return {}; }
 kres_err make_header(archive* ar) {
     if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
 
+    // the volume of a record has to fit into the top bits of its offset, checked before anything
+    // is taken out of the old header
+    record_layout layout = plan_records(*ar);
+    if ((ar->header.flags & KRES_FLAG_VOLUMES) && layout.volume_starts.size() > KRES_MAX_VOLUMES) {
+        return KRES_INVALID_STATE;
+    }
+
     header tmp_header;
     tmp_header.flags = ar->header.flags;
+    // the field by field open of archives without a superblock stops before these sections
+    if (tmp_header.flags & (KRES_FLAG_PAGED_INDEX | KRES_FLAG_SOURCE_META | KRES_FLAG_ATTRIBUTES |
+                            KRES_FLAG_GENERATIONS)) {
+        tmp_header.flags |= KRES_FLAG_SUPERBLOCK;
+    }
     tmp_header.version = ar->header.version;
     tmp_header.user_section_size = ar->header.user_section_size;
-    tmp_header.user_section = ar->header.user_section;
-    tmp_header.entry_count = ar->entries.size();
+    tmp_header.user_section = std::move(ar->header.user_section);
+    tmp_header.solid_entry_limit = ar->header.solid_entry_limit;
+    tmp_header.solid_block_size = ar->header.solid_block_size;
 
-    size_t header_size = 4 + 4 + 4 + 8;
-    header_size += ar->entries.size() * 16;
-    header_size += 8 + ar->header.user_section_size;
-
-    uint64_t current_offset = header_size;
+    tmp_header.volume_size_cap = ar->header.volume_size_cap;
+    tmp_header.entry_count = ar->entries.size();
+    if (tmp_header.flags & KRES_FLAG_SOURCE_META) {
+        for (const auto& e : ar->entries) {
+            if (e.source_mtime != 0) {
+                tmp_header.source_meta.push_back({generate_id(e.filename), e.source_mtime, e.size});
+            }
+        }
+        tmp_header.source_meta_count = tmp_header.source_meta.size();
+    }
+    if (tmp_header.flags & KRES_FLAG_ATTRIBUTES) {
+        tmp_header.attribute_columns = std::move(ar->header.attribute_columns);
+        build_attribute_section(ar->entries, tmp_header.attribute_columns,
+                                &tmp_header.attribute_section);
+        tmp_header.attribute_crc =
+            crc32(tmp_header.attribute_section.data(), tmp_header.attribute_section.size());
+    }
 
-    ar->header.offset_table.reserve(ar->entries.size());
-    ar->header.filename_table.reserve(ar->entries.size());
+    trace_scope trace("index_build", ar->entries.size());
+    const auto& blocks = layout.blocks;
+    tmp_header.block_table.resize(blocks.size());
+    if (tmp_header.flags & KRES_FLAG_ID_FILTER) {
+        tmp_header.id_filter.resize(filter_block_count(tmp_header.entry_count));
+    }
+    bool volumes = tmp_header.flags & KRES_FLAG_VOLUMES;
+    if (volumes) tmp_header.volume_sizes.assign(layout.volume_starts.size() + 1, 0);
+
+    // records of split archives start over at 0 in every volume file
+    uint64_t current_offset = volumes ? 0 : header_size(tmp_header);
+    if (volumes) tmp_header.volume_sizes[0] = header_size(tmp_header);
+    tmp_header.offset_table.reserve(ar->entries.size());
+    tmp_header.filename_table.reserve(ar->entries.size());
+
+    size_t next_block = 0;
+    size_t volume = 0;
+    for (size_t pos = 0; pos < layout.order.size(); pos++) {
+        if (volume < layout.volume_starts.size() && layout.volume_starts[volume] == pos) {
+            if (volume > 0) tmp_header.volume_sizes[volume] = offset_local(current_offset);
+            volume++;
+            current_offset = volume_offset(volume, 0);
+        }
+        if (next_block < blocks.size() && blocks[next_block].first == pos) {
+            tmp_header.block_table[next_block].offset = current_offset;
+        }
 
-    for (auto& entry : ar->entries) {
+        const entry& entry = ar->entries[layout.order[pos]];
         id e_id = generate_id(entry.filename);
 
-        ar->header.offset_table[e_id] = current_offset;
-        ar->header.filename_table[e_id] = entry.filename;
+        tmp_header.offset_table[e_id] = current_offset;
+        tmp_header.filename_table[e_id] = entry.filename;
+        if (!tmp_header.id_filter.empty()) filter_insert(tmp_header.id_filter, e_id);
+
+        current_offset += record_size(entry);
 
-        current_offset += 4 + entry.filename.length() + 1 + 4 + 8 + entry.size;
+        if (next_block < blocks.size() &&
+            blocks[next_block].first + blocks[next_block].second == pos + 1) {
+            auto& block = tmp_header.block_table[next_block++];
+            block.size = current_offset - block.offset;
+        }
     }
+    if (volume > 0) tmp_header.volume_sizes[volume] = offset_local(current_offset);
 
-    ar->header = tmp_header;
+    ar->header = std::move(tmp_header);
     return KRES_OK;
 }
 
-kres_err append_entry(archive* ar, const entry& e) {
+kres_err append_entry(archive* ar, const entry& e) { return append_entry(ar, entry(e)); }
+
+kres_err append_entry(archive* ar, entry&& e) {
     if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
 
     id e_id = generate_id(e.filename);
     if (ar->header.offset_table.contains(e_id)) {
-        if (ar->entries[e_id].data == e.data) return KRES_ERROR_DUPLICATE_ENTRY;
         // TODO: trigger some kind of redundancy duplicate id resolution, or could just error out
         // for now i guess ?
         return KRES_ERROR_DUPLICATE_ENTRY;  // for now just error out
     } else {
-        ar->entries.push_back(e);
+        ar->entries.push_back(std::move(e));
     }
 
     return make_header(ar);
 }
 
-kres_err append_entry(archive* ar, const string& filename, bool recurse) {
+kres_err append_entry(archive* ar, const entry_desc& desc) {
+    entry e;
+    e.filename = desc.filename;
+    e.filename_len = static_cast<uint32_t>(desc.filename.length());
+
+    if (desc.source) {
+        e.source = desc.source;
+        e.size = desc.size;
+        e.crc32 = 0;
+    } else if (!desc.source_path.empty()) {
+        e.source_path = desc.source_path;
+        e.source_offset = desc.source_offset;
+        e.size = desc.size;
+        e.crc32 = 0;
+    } else {
+        e.view = desc.data;
+        e.size = desc.data.size();
+        e.crc32 = crc32(desc.data.data(), desc.data.size());
+    }
+    e.attributes = desc.attributes;
+
+    return append_entry(ar, std::move(e));
+}
+
+// builds the entry for a single file on disk, name is what it will be called inside the archive
+static kres_err make_file_entry(const std::filesystem::path& path,
+                                const string& name,
+                                bool deferred,
+                                entry* e) {
+    std::error_code ec;
+    e->filename = name;
+    e->filename_len = static_cast<uint32_t>(name.length());
+    e->size = std::filesystem::file_size(path, ec);
+    if (ec) return KRES_ERROR_INVALID_INPUT_FILE;
+    e->source_mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    if (ec) return KRES_ERROR_INVALID_INPUT_FILE;
+
+    if (deferred) {
+        e->source_path = path.string();
+        e->crc32 = 0;
+        return KRES_OK;
+    }
+
+    e->data.resize(e->size);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return KRES_ERROR_FAILED_IO;
+    file.read(reinterpret_cast<char*>(e->data.data()), static_cast<std::streamsize>(e->size));
+    if (static_cast<uint64_t>(file.gcount()) != e->size) return KRES_ERROR_FAILED_IO;
+
+    e->crc32 = crc32(e->data.data(), e->size);
+    return KRES_OK;
+}
+
+kres_err append_entry(archive* ar, const string& filename, bool recurse, bool deferred) {
     if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
 
-    entry e;
     using namespace std::filesystem;
+    path root(filename);
+
+    if (is_regular_file(root)) {
+        entry e;
+        auto err = make_file_entry(root, root.filename().generic_string(), deferred, &e);
+        if (err != KRES_OK) return err;
+        return append_entry(ar, std::move(e));
+    }
+    if (!is_directory(root)) return KRES_ERROR_INVALID_INPUT_FILE;
 
-    if (is_regular_file(filename)) {
-        e.size = file_size(filename);
-        e.data.reserve(e.size);
+    vec<path> files;
+    if (recurse) {
+        for (const auto& file : recursive_directory_iterator(root)) {
+            if (file.is_regular_file()) files.push_back(file.path());
+        }
+    } else {
+        for (const auto& file : directory_iterator(root)) {
+            if (file.is_regular_file()) files.push_back(file.path());
+        }
+    }
 
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) return KRES_ERROR_FAILED_IO;
-        file.read(reinterpret_cast<char*>(e.data.data()), e.size);
+    std::sort(files.begin(), files.end());  // same tree, same archive
+
+    // the whole directory is collected before the header is rebuilt once, instead of once per file,
+    // nothing is added if any file fails
+    vec<entry> entries(files.size());
+    std::unordered_set<id> added;
+    added.reserve(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        entry& e = entries[i];
+        string name = files[i].lexically_relative(root).generic_string();
+        auto err = make_file_entry(files[i], name, deferred, &e);
+        if (err != KRES_OK) return err;
 
-        return append_entry(ar, e);
-    } else if (is_directory(filename)) {
-        for (const auto& file : directory_iterator(filename)) {
-            if (file.is_directory() && !recurse) continue;
-            append_entry(ar, file.path().string(), recurse);
+        id e_id = generate_id(e.filename);
+        if (ar->header.offset_table.contains(e_id) || !added.insert(e_id).second) {
+            return KRES_ERROR_DUPLICATE_ENTRY;
         }
     }
 
-    return KRES_INVALID_STATE;
+    ar->entries.insert(ar->entries.end(),
+                       std::make_move_iterator(entries.begin()),
+                       std::make_move_iterator(entries.end()));
+    return make_header(ar);
 }
 
-kres_err set_user_data(archive* ar, const byte_vec& ud) {
+kres_err set_user_data(archive* ar, const byte_vec& ud) { return set_user_data(ar, byte_vec(ud)); }
+
+kres_err set_user_data(archive* ar, byte_vec&& ud) {
     if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
 
     ar->header.user_section_size = ud.size();
-    ar->header.user_section = ud;
+    ar->header.user_section = std::move(ud);
 
     return make_header(ar);
 }
@@ -281,46 +1400,206 @@ kres_err set_user_data(archive* ar, const byte_vec& ud) {
 kres_err preload_archive(archive* ar, const string& filename) {
     if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
 
+    trace_scope trace("header_parse");
     header h;
     file_reader r;
+    r.stats = ar->stats;
     using namespace std::filesystem;
-    if (!is_regular_file(filename) || !exists(filename)) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+    std::error_code ec;
+    if (!is_regular_file(filename, ec)) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+    uint64_t file_size = std::filesystem::file_size(filename, ec);
+    if (ec) return KRES_ERROR_INVALID_ARCHIVE_FILE;
 
     auto err = r.open(filename.c_str());
-    if (!err) return err;
+    if (err != KRES_OK) return err;
 
-    err = r.read_u32(&h.magic);
-    if (!err) return err;
+    // speculative first read, big enough to hold the whole index of most archives
+    constexpr uint64_t first_read = 16 * 1024;
+    byte_vec buf;
+    err = r.read_bytes(std::min(file_size, first_read), &buf);
+    if (err != KRES_OK) return err;
+    if (buf.size() < KRES_FIXED_HEADER_SIZE) return KRES_ERROR_INVALID_ARCHIVE;
+    if (load_le32(buf.data()) != KRES_MAGIC) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (load_le32(buf.data() + 8) & KRES_FLAG_SUPERBLOCK) {
+        if (buf.size() < KRES_SUPERBLOCK_SIZE) return KRES_ERROR_INVALID_ARCHIVE;
+        uint64_t index = load_le64(buf.data() + KRES_FIXED_HEADER_SIZE + 8);
+        if (index > file_size) return KRES_ERROR_INVALID_ARCHIVE;
+
+        size_t have = buf.size();
+        buf.resize(index);
+        if (index > have) {
+            err = r.read_into(buf.data() + have, index - have);  // the reader is right after have
+            if (err != KRES_OK) return err;
+        }
+
+        trace_scope trace("index_build", load_le64(buf.data() + 12));
+        err = parse_index(buf, &h, false);
+        if (err != KRES_OK) return err;
+
+        // appended to in place, the root slots say which index is the latest
+        if (h.flags & KRES_FLAG_GENERATIONS) {
+            err = open_latest_generation(&r, &h);
+            if (err != KRES_OK) return err;
+        }
 
-    if (h.magic != KRES_MAGIC) return KRES_ERROR_INVALID_ARCHIVE;
+        ar->header = std::move(h);
+        ar->path = filename;
+        return KRES_OK;
+    }
 
-    err = r.read_u32(&h.version);
-    if (!err) return err;
-    err = r.read_u32(&h.flags);
-    if (!err) return err;
-    err = r.read_u64(&h.entry_count);
-    if (!err) return err;
+    // no superblock, nothing says how long the header is, so it is walked field by field
+    byte_reader fixed;
+    fixed.buffer = &buf;
+    fixed.pos = 0;
+    fixed.read_u32(&h.magic);
+    fixed.read_u32(&h.version);
+    fixed.read_u32(&h.flags);
+    fixed.read_u64(&h.entry_count);
+    if (h.flags & ~KRES_FLAGS_KNOWN) return KRES_ERROR_MISMATCHED_VERSION;
+    if (h.flags & (KRES_FLAG_PAGED_INDEX | KRES_FLAG_GENERATIONS)) {
+        return KRES_ERROR_INVALID_ARCHIVE;
+    }
+    err = r.seek(KRES_FIXED_HEADER_SIZE);
+    if (err != KRES_OK) return err;
 
-    h.offset_table.reserve(h.entry_count);
-    for (uint64_t i = 0; i < h.entry_count; i++) {
-        id e_id;
-        uint64_t offset;
-        err = r.read_u64(&e_id);
-        if (!err) return err;
-        err = r.read_u64(&offset);
-        if (!err) return err;
-        h.offset_table[e_id] = offset;
+    {
+        trace_scope trace("index_build", h.entry_count);
+        h.offset_table.reserve(h.entry_count);
+        for (uint64_t i = 0; i < h.entry_count; i++) {
+            id e_id;
+            uint64_t offset;
+            err = r.read_u64(&e_id);
+            if (err != KRES_OK) return err;
+            err = r.read_u64(&offset);
+            if (err != KRES_OK) return err;
+            h.offset_table[e_id] = offset;
+        }
     }
 
     err = r.read_u64(&h.user_section_size);
-    if (!err) return err;
+    if (err != KRES_OK) return err;
 
+    h.user_section_offset = KRES_FIXED_HEADER_SIZE + h.entry_count * 16 + 8;
     if (h.user_section_size > 0) {
         err = r.read_bytes(h.user_section_size, &h.user_section);
-        if (!err) return err;
+        if (err != KRES_OK) return err;
+    }
+
+    if (h.flags & KRES_FLAG_SOLID) {
+        uint64_t block_count;
+        err = r.read_u64(&block_count);
+        if (err != KRES_OK) return err;
+        if (block_count > h.entry_count) return KRES_ERROR_INVALID_ARCHIVE;
+        h.block_table.resize(block_count);
+        for (auto& block : h.block_table) {
+            err = r.read_u64(&block.offset);
+            if (err != KRES_OK) return err;
+            err = r.read_u64(&block.size);
+            if (err != KRES_OK) return err;
+        }
+    }
+
+    if (h.flags & KRES_FLAG_ID_FILTER) {
+        err = read_id_filter(&r, h.entry_count, &h.id_filter);
+        if (err != KRES_OK) return err;
     }
 
+    if (h.flags & KRES_FLAG_VOLUMES) {
+        uint64_t volume_count;
+        err = r.read_u64(&h.volume_size_cap);
+        if (err != KRES_OK) return err;
+        err = r.read_u64(&volume_count);
+        if (err != KRES_OK) return err;
+        if (volume_count == 0 || volume_count > h.entry_count + 1) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        h.volume_sizes.resize(volume_count);
+        for (uint64_t& size : h.volume_sizes) {
+            err = r.read_u64(&size);
+            if (err != KRES_OK) return err;
+        }
+    }
+
+    ar->header = std::move(h);
+    ar->path = filename;
+    return KRES_OK;
+}
+
+kres_err read_user_section(const archive& ar, byte_vec* out) {
+    if (!out) return KRES_INVALID_STATE;
+
+    const header& h = ar.header;
+    if (h.user_section.size() == h.user_section_size) {
+        *out = h.user_section;
+        return KRES_OK;
+    }
+    if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+
+    file_reader r;
+    r.stats = ar.stats;
+    auto err = r.open(ar.path.c_str());
+    if (err != KRES_OK) return err;
+    err = r.seek(h.user_section_offset);
+    if (err != KRES_OK) return err;
+    return r.read_bytes(h.user_section_size, out);
+}
+
+kres_err load_user_section(archive* ar) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+    if (ar->header.user_section.size() == ar->header.user_section_size) return KRES_OK;
+
+    byte_vec data;
+    auto err = read_user_section(*ar, &data);
+    if (err != KRES_OK) return err;
+    ar->header.user_section = std::move(data);
     return KRES_OK;
 }
 
+kres_err read_entry_at(file_reader* r, uint64_t offset, entry* out) {
+    if (!r || !out) return KRES_INVALID_STATE;
+
+    auto err = r->seek(offset);
+    if (err != KRES_OK) return err;
+
+    err = r->read_u32(&out->filename_len);
+    if (err != KRES_OK) return err;
+    err = r->read_string(&out->filename);
+    if (err != KRES_OK) return err;
+    err = r->read_u32(&out->crc32);
+    if (err != KRES_OK) return err;
+    err = r->read_u64(&out->size);
+    if (err != KRES_OK) return err;
+
+    return r->read_bytes(out->size, &out->data);
+}
+
+kres_err read_entry(const archive& ar, id entry_id, entry* out) {
+    auto start = ar.stats ? stats_clock::now() : stats_clock::time_point{};
+    uint64_t offset = 0;
+    kres_err err = KRES_ERROR_ENTRY_NOT_FOUND;
+    if (may_contain(ar.header, entry_id)) err = find_offset(ar, entry_id, &offset);
+    if (ar.stats) ar.stats->record_lookup(err == KRES_OK, stats_nanos_since(start));
+    if (err != KRES_OK) return err;
+    if (ar.recorder) ar.recorder->record(entry_id);
+
+    trace_scope trace("entry_read", entry_id);
+    start = stats_clock::now();
+    if (const solid_block* block = ar.cache ? find_block(ar.header, offset) : nullptr) {
+        err = read_block_entry(ar, *block, offset, out);
+    } else {
+        file_reader r;
+        r.stats = ar.stats;
+        err = r.open(volume_path(ar.path, offset_volume(offset)).c_str());
+        if (err != KRES_OK) return err;
+        err = read_entry_at(&r, offset_local(offset), out);
+    }
+    if (ar.stats) ar.stats->read_latency.record(stats_nanos_since(start));
+    return err;
+}
+
+kres_err read_entry(const archive& ar, const string& filename, entry* out) {
+    return read_entry(ar, generate_id(filename), out);
+}
+
 }  // namespace kres
\ No newline at end of file
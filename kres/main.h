@@ -4,11 +4,15 @@
 #include <cstddef>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <span>
 
 #include <xxhash.h>
 #include "hash/crc32.h"
+#include "hash/xxh3_constexpr.h"
 
+#include "trace.h"
 #include "types.h"
 #include "utility.h"
 
@@ -17,10 +21,36 @@
 
 namespace kres {
 
-constexpr uint32_t KRES_VERSION = VERSION_ENCODE(0, 0, 1);
+// 0.1 moved the user section behind the index of superblock archives (now the default), every flag
+// since is a layout change as well, so readers reject bits they don't know instead of misparsing
+constexpr uint32_t KRES_VERSION = VERSION_ENCODE(0, 1, 0);
 constexpr uint32_t KRES_MAGIC =
     0x4B524553;  // ascii for "KRES" (reversed in archives, due to endianness)
 
+// header::flags bits
+constexpr uint32_t KRES_FLAG_SOLID = 1u << 0;       // small entries packed in blocks, see solid.h
+constexpr uint32_t KRES_FLAG_ID_FILTER = 1u << 1;   // header carries an id filter, see filter.h
+constexpr uint32_t KRES_FLAG_SUPERBLOCK = 1u << 2;  // lengths + checksum up front, see header
+constexpr uint32_t KRES_FLAG_VOLUMES = 1u << 3;     // records live in volume files, see volume.h
+constexpr uint32_t KRES_FLAG_PAGED_INDEX = 1u << 4;  // offsets live in index pages, see paged.h
+constexpr uint32_t KRES_FLAG_SOURCE_META = 1u << 5;  // source file stats, see build_cache.h
+constexpr uint32_t KRES_FLAG_ATTRIBUTES = 1u << 6;   // attribute columns, see attributes.h
+constexpr uint32_t KRES_FLAG_GENERATIONS = 1u << 7;  // appended to in place, see generation.h
+constexpr uint32_t KRES_FLAGS_KNOWN = KRES_FLAG_SOLID | KRES_FLAG_ID_FILTER | KRES_FLAG_SUPERBLOCK |
+                                      KRES_FLAG_VOLUMES | KRES_FLAG_PAGED_INDEX |
+                                      KRES_FLAG_SOURCE_META | KRES_FLAG_ATTRIBUTES |
+                                      KRES_FLAG_GENERATIONS;
+
+// magic through entry_count, plus the superblock right after it when KRES_FLAG_SUPERBLOCK is set
+constexpr uint64_t KRES_FIXED_HEADER_SIZE = 4 + 4 + 4 + 8;
+constexpr uint64_t KRES_SUPERBLOCK_SIZE = KRES_FIXED_HEADER_SIZE + 8 + 8 + 4;
+
+// KRES_FLAG_GENERATIONS archives keep two root slots right after the user section, see generation.h
+constexpr uint64_t KRES_ROOT_SLOT_SIZE = 32;
+constexpr uint64_t root_area_size(uint32_t flags) {
+    return flags & KRES_FLAG_GENERATIONS ? 2 * KRES_ROOT_SLOT_SIZE : 0;
+}
+
 struct version_t {
     uint8_t major;
     uint8_t minor;
@@ -35,39 +65,132 @@ inline version_t version_decode(uint32_t version) {
     return v;
 }
 
+// fills the whole payload of a generated entry, called once when the archive is serialized
+using entry_source = std::function<kres_err(std::span<std::byte> out)>;
+
 struct entry {
     uint32_t filename_len;
     string filename;  // needs to be null terminated
     uint32_t crc32;
     uint64_t size;
     byte_vec data;
+
+    // utility fields not stored in the format, set up through entry_desc, when one of them is set
+    // data stays empty and the payload is taken from there at serialization time
+    std::span<const std::byte> view;  // borrowed, has to outlive serialization
+    entry_source source;              // generated, crc32 is computed while serializing
+    string source_path;               // file backed, size bytes starting at source_offset are
+    uint64_t source_offset = 0;       // copied file to file and checksummed while serializing
+    bool source_record = false;  // source_offset points at this whole record in another archive,
+                                 // copied as is, see build_cache.h
+    int64_t source_mtime = 0;    // of the file the entry was read from, 0 when it wasn't
+    vec<uint64_t> attributes;    // one value per header::attribute_columns, missing ones are 0
+};
+
+// describes an entry without handing over its payload, either borrow bytes the caller holds,
+// provide a source that produces them, or point at a file, size is required for the latter two
+struct entry_desc {
+    string filename;
+    std::span<const std::byte> data;
+    entry_source source;
+    uint64_t size = 0;
+    string source_path;
+    uint64_t source_offset = 0;
+    vec<uint64_t> attributes;
+};
+
+// a run of small records stored back to back, read (and cached) as a whole
+struct solid_block {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// one cache line worth of filter bits, an id sets one bit in each word
+struct alignas(32) filter_block {
+    uint32_t words[8];
+};
+
+// first id and crc32 of one page of a paged index
+struct index_fence {
+    id first;
+    uint32_t crc;
+};
+
+// name and value type (KRES_ATTR_*) of one attribute column
+struct attribute_column {
+    string name;
+    uint32_t type;
+};
+
+// stats of the file an entry was read from when the archive was built
+struct file_stat {
+    id entry_id;
+    int64_t mtime;  // std::filesystem::file_time_type ticks
+    uint64_t size;
 };
 
 // the ids and offsets are in this pattern to make access easier here, in memory we store them as:
 // id, offset, id, offset... | 8bytes, 8bytes, 8bytes, 8bytes...
+//
+// with KRES_FLAG_SUPERBLOCK (the default for new archives) entry_count is followed by the header
+// size (u64, where the first record starts), the index size (u64, everything before the user
+// section data) and a crc32 of the index with the crc field itself skipped, the user section then
+// comes last so a reader gets the whole index with one read, can verify it and leave the user data
+// on disk, archives without the flag keep the user section right after the offset table
 struct header {
     uint32_t magic = KRES_MAGIC;      // identify valid kres archives
     uint32_t version = KRES_VERSION;  // to detect changes in api
-    uint32_t flags = 0;               // currently unused, reserved for later
+    uint32_t flags = KRES_FLAG_SUPERBLOCK;  // KRES_FLAG_* bits
     uint64_t entry_count = 0;
-    map<id, uint64_t> offset_table;  // in file stored side by side with the offsets
+    map<id, uint64_t> offset_table;  // in file stored side by side with the offsets, paged archives
+                                     // leave it empty when opened, see paged.h
     uint64_t user_section_size = 0;
     byte_vec user_section;  // user section contains arbitrary data the user might want to embed
+    vec<solid_block> block_table;  // only stored with KRES_FLAG_SOLID, count + (offset, size) pairs
+    vec<filter_block> id_filter;   // only stored with KRES_FLAG_ID_FILTER, count + blocks
+    uint64_t volume_size_cap = 0;  // only stored with KRES_FLAG_VOLUMES, 0 = no cap
+    vec<uint64_t> volume_sizes;    // same, count + size per volume, volume 0 is the index file
+    vec<index_fence> page_fence;   // only stored with KRES_FLAG_PAGED_INDEX, in place of the offset
+                                   // table, count + (first id, crc) per page
+    uint64_t source_meta_count = 0;  // only stored with KRES_FLAG_SOURCE_META, count + (id, mtime,
+    vec<file_stat> source_meta;      // size) per entry, left on disk when parsed, see build_cache.h
+    vec<attribute_column> attribute_columns;  // only stored with KRES_FLAG_ATTRIBUTES, count +
+    uint32_t attribute_crc = 0;               // (type, name) per column, then the crc of the
+                                              // columns themselves, which follow the index
 
     // utility fields not stored in the format
     map<id, string> filename_table;  // will not be populated if the archive is not fully parsed
+    uint64_t user_section_offset = 0;  // where the user data starts in the file, set when parsed
+    uint64_t source_meta_offset = 0;   // where the source meta rows start, set when parsed
+    byte_vec attribute_section;  // the encoded columns, built by make_header, empty when parsed
+    uint64_t generation = 0;    // of the index this header was read from, see generation.h
+    uint64_t index_offset = 0;  // where that index starts in the file, 0 for generation 0
+    uint64_t root_offset = 0;   // where the root slots are, set when parsed
+    uint64_t solid_entry_limit = 1024;      // entries up to this size go into blocks
+    uint64_t solid_block_size = 64 * 1024;  // a block is closed once it reaches this size
 };
 
+struct access_recorder;
+struct block_cache;
+struct index_map;
+
 // defines the structure of a kres archive, serializes/deserialized with specific functions to and
 // from byte_vec
 struct archive {
     byte_vec raw_data;
 
     // format fields
-    header header;
+    kres::header header;
 
     // end of header, data section
     vec<entry> entries;
+
+    // utility fields not stored in the format
+    string path;  // set by preload_archive, entries are read from here on demand
+    reader_stats* stats = nullptr;        // opt-in, not owned, see stats.h
+    access_recorder* recorder = nullptr;  // opt-in, not owned, see profile.h
+    block_cache* cache = nullptr;         // opt-in, not owned, see solid.h and paged.h
+    const index_map* index_pages = nullptr;  // opt-in, not owned, see paged.h
 };
 
 [[deprecated]] bool validate_archive(
@@ -75,11 +198,22 @@ struct archive {
                             // the same as the current one in KRES_VERSION
 bool validate_archive(const string& filename);
 bool validate_entry(const entry& entry);  // uses the crc32 sum to validate singular entries
+bool validate_entry(const entry& entry, reader_stats* stats);  // same, but records checksum time
 
 inline id generate_id(const string& filename) {
     return XXH3_64bits(filename.c_str(), filename.length());
 }
 
+// compile time version of generate_id, always yields the same id for the same path
+constexpr id const_id(std::string_view filename) { return xxh3::hash64(filename); }
+
+namespace literals {
+// "textures/logo.png"_id
+consteval id operator""_id(const char* filename, size_t len) {
+    return const_id(std::string_view(filename, len));
+}
+}  // namespace literals
+
 inline const char* get_filename_ptr(const byte_vec& data, uint64_t offset, uint32_t* len_out) {
     *len_out = static_cast<uint32_t>(data[offset]) |
                (static_cast<uint32_t>(data[offset + 1]) << 8) |
@@ -89,7 +223,32 @@ inline const char* get_filename_ptr(const byte_vec& data, uint64_t offset, uint3
     return reinterpret_cast<const char*>(data.data() + offset + 4);
 }
 
+// exact on-disk sizes, make_header lays offsets out with these and serialize_archive allocates its
+// output once from them
+uint64_t header_size(const header& h);
+uint64_t index_size(const header& h);  // header_size minus the user section data
+// crc32 of a serialized index with the crc field (the last 4 bytes of the superblock) left out
+uint32_t header_crc(const std::byte* index, uint64_t size);
+uint64_t record_size(const entry& e);
+uint64_t serialized_size(const archive& arch);
+
+// split archives (KRES_FLAG_VOLUMES) span several files and are rejected with KRES_INVALID_STATE
 kres_err serialize_archive(const archive& arch, byte_vec* out);
+// streams the archive straight into a file, payloads are handed to the kernel from the entries
+// themselves (gather writes) instead of being copied into one big buffer first, the records of
+// split archives go to the volume files next to filename instead
+kres_err serialize_archive(const archive& arch, const string& filename);
+// same output as serialize_archive, but the files are allocated at their final size up front and
+// the records are written concurrently with positional writes by threads (0 picks
+// hardware_concurrency), the header last. source callbacks of generated entries are called from
+// those threads, possibly at the same time, so they must be safe for that. plain serialize_archive
+// on windows
+kres_err serialize_archive_parallel(const archive& arch,
+                                    const string& filename,
+                                    uint32_t threads = 0);
+// writes the records of arch's entries, in entry order, into an existing file starting at offset,
+// nothing is truncated, how archives are appended to in place, see generation.h
+kres_err write_records_at(const string& filename, const archive& arch, uint64_t offset);
 [[deprecated("use preload_archive instead")]] kres_err parse_header(const byte_vec& data,
                                                                     header* h);
 [[deprecated]] kres_err extract_entry_by_id(const byte_vec& data,
@@ -99,6 +258,9 @@ kres_err serialize_archive(const archive& arch, byte_vec* out);
 [[deprecated]] kres_err build_archive(const vec<entry>& entries,
                                       archive* out,
                                       const byte_vec* user_data = nullptr);
+[[deprecated]] kres_err build_archive(vec<entry>&& entries,
+                                      archive* out,
+                                      const byte_vec* user_data = nullptr);
 [[deprecated]] kres_err extract_entry_by_name(const byte_vec& data,
                                               const header& h,
                                               const string& filename,
@@ -120,13 +282,40 @@ archive init_archive();
 // data
 kres_err make_header(archive* ar);
 kres_err append_entry(archive* ar, const entry& e);
-kres_err append_entry(archive* ar, const string& filename, bool recurse = false);
+kres_err append_entry(archive* ar, entry&& e);
+// the payload is never copied into the archive, see entry_desc
+kres_err append_entry(archive* ar, const entry_desc& desc);
+// adds a file, or every file in a directory (names relative to it), deferred entries only record
+// path and size and are streamed in when the archive is serialized, so packing uses little memory
+kres_err append_entry(archive* ar,
+                      const string& filename,
+                      bool recurse = false,
+                      bool deferred = false);
 kres_err set_user_data(archive* ar, const byte_vec& ud);
+kres_err set_user_data(archive* ar, byte_vec&& ud);
 
 // does the same as parse_header, but uses a better reader, which does not load the whole archive
-// into memory
+// into memory, archives with a superblock are opened with a single read of the index (two when it
+// is larger than the first speculative read), checked against the header crc, the user section is
+// left on disk until load_user_section
 kres_err preload_archive(archive* ar, const string& filename);
 
+// parses a header held in memory, with user_data false the user section of a superblock archive is
+// only located and data only has to hold the index, otherwise it has to hold the whole header
+kres_err parse_index(const byte_vec& data, header* h, bool user_data);
+
+// brings header.user_section in from the file of a preloaded archive, no-op when already there
+kres_err load_user_section(archive* ar);
+// same, but leaves the archive alone and reads into out
+kres_err read_user_section(const archive& ar, byte_vec* out);
+
+// reads a single record starting at offset, the reader is left positioned right after it
+kres_err read_entry_at(file_reader* r, uint64_t offset, entry* out);
+// reads a single entry from the file a preloaded archive was opened from, without touching the rest
+// of the data section
+kres_err read_entry(const archive& ar, id entry_id, entry* out);
+kres_err read_entry(const archive& ar, const string& filename, entry* out);
+
 }  // namespace kres
 
 #endif  // KRES_MAIN_H
@@ -0,0 +1,118 @@
+#include "mount.h"
+
+#include <algorithm>
+
+#include "filter.h"
+#include "paged.h"
+#include "profile.h"
+#include "solid.h"
+#include "volume.h"
+
+namespace kres {
+
+kres_err mount_archives(mount_set* ms, const vec<pair<string, int32_t>>& archives) {
+    if (!ms) return KRES_INVALID_STATE;
+
+    vec<mount_layer> layers(archives.size());
+    for (size_t i = 0; i < archives.size(); i++) {
+        auto err = preload_archive(&layers[i].ar, archives[i].first);
+        if (err != KRES_OK) return err;
+        layers[i].priority = archives[i].second;
+    }
+
+    // stable + reversed keeps "later wins" for layers that share a priority
+    std::reverse(layers.begin(), layers.end());
+    std::stable_sort(layers.begin(), layers.end(), [](const mount_layer& a, const mount_layer& b) {
+        return a.priority > b.priority;
+    });
+
+    size_t total = 0;
+    for (const auto& layer : layers) total += layer.ar.header.offset_table.size();
+
+    trace_scope trace("index_build", total);
+    map<id, mount_hit> index;
+    index.reserve(total);
+    vec<uint32_t> paged;
+    for (uint32_t l = 0; l < layers.size(); l++) {
+        const header& h = layers[l].ar.header;
+        if ((h.flags & KRES_FLAG_PAGED_INDEX) && !index_loaded(h)) {
+            paged.push_back(l);
+            continue;
+        }
+        for (const auto& [e_id, offset] : h.offset_table) {
+            index.try_emplace(e_id, mount_hit{l, offset});
+        }
+    }
+
+    // layer filters differ in size and can't be merged, so the set gets its own
+    vec<filter_block> filter(filter_block_count(index.size()));
+    for (const auto& [e_id, hit] : index) filter_insert(filter, e_id);
+
+    ms->layers = std::move(layers);
+    ms->index = std::move(index);
+    ms->filter = std::move(filter);
+    ms->paged = std::move(paged);
+    return KRES_OK;
+}
+
+kres_err mount_find(const mount_set& ms, id entry_id, mount_hit* out) {
+    auto start = ms.stats ? stats_clock::now() : stats_clock::time_point{};
+    auto it = ms.index.end();
+    if (filter_may_contain(ms.filter, entry_id)) it = ms.index.find(entry_id);
+    kres_err err = KRES_ERROR_ENTRY_NOT_FOUND;
+    if (it != ms.index.end()) {
+        *out = it->second;
+        err = KRES_OK;
+    }
+
+    // only paged layers that outrank the merged hit can shadow it, each reads the one page that
+    // can hold the id, and only when its own filter lets the id through
+    uint32_t limit = err == KRES_OK ? out->layer : static_cast<uint32_t>(ms.layers.size());
+    for (uint32_t l : ms.paged) {
+        if (l >= limit) break;
+        const archive& layer = ms.layers[l].ar;
+        if (!may_contain(layer.header, entry_id)) continue;
+
+        uint64_t offset;
+        auto found = find_offset(layer, entry_id, &offset);
+        if (found == KRES_ERROR_ENTRY_NOT_FOUND) continue;
+        err = found;
+        if (err == KRES_OK) *out = mount_hit{l, offset};
+        break;
+    }
+    if (ms.stats) ms.stats->record_lookup(err == KRES_OK, stats_nanos_since(start));
+    return err;
+}
+
+kres_err mount_find(const mount_set& ms, const string& filename, mount_hit* out) {
+    return mount_find(ms, generate_id(filename), out);
+}
+
+kres_err mount_read_entry(const mount_set& ms, id entry_id, entry* out) {
+    mount_hit hit;
+    auto err = mount_find(ms, entry_id, &hit);
+    if (err != KRES_OK) return err;
+
+    const archive& layer = ms.layers[hit.layer].ar;
+    if (layer.recorder) layer.recorder->record(entry_id);
+
+    trace_scope trace("entry_read", entry_id);
+    auto start = stats_clock::now();
+    if (const solid_block* block = layer.cache ? find_block(layer.header, hit.offset) : nullptr) {
+        err = read_block_entry(layer, *block, hit.offset, out, ms.stats);
+    } else {
+        file_reader r;
+        r.stats = ms.stats;
+        err = r.open(volume_path(layer.path, offset_volume(hit.offset)).c_str());
+        if (err != KRES_OK) return err;
+        err = read_entry_at(&r, offset_local(hit.offset), out);
+    }
+    if (ms.stats) ms.stats->read_latency.record(stats_nanos_since(start));
+    return err;
+}
+
+kres_err mount_read_entry(const mount_set& ms, const string& filename, entry* out) {
+    return mount_read_entry(ms, generate_id(filename), out);
+}
+
+}  // namespace kres
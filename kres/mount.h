@@ -0,0 +1,44 @@
+#ifndef KRES_MOUNT_H
+#define KRES_MOUNT_H
+
+#include "main.h"
+
+namespace kres {
+
+struct mount_layer {
+    archive ar;            // preloaded, a paged index stays on disk until a lookup needs a page
+    int32_t priority = 0;  // higher priority layers shadow lower ones
+};
+
+// where a mounted id resolved to, the layer index points into mount_set::layers
+struct mount_hit {
+    uint32_t layer;
+    uint64_t offset;
+};
+
+// overlays several archives (base, dlc, patches, mods...) into a single view, the offset tables of
+// the loaded layers are merged once at mount time so a lookup is a single probe no matter how many
+// of them are mounted. paged layers keep their index on disk, a lookup only asks those that outrank
+// the merged hit, filter first, so their pages are read just for ids they may hold
+struct mount_set {
+    vec<mount_layer> layers;        // sorted by priority, highest first
+    map<id, mount_hit> index;       // immutable after mount_archives, winning hit per loaded id
+    vec<filter_block> filter;       // over every id in index, misses are answered without probing
+    vec<uint32_t> paged;            // layers not in index, highest priority first
+    reader_stats* stats = nullptr;  // opt-in, not owned, see stats.h
+};
+
+// preloads every archive and builds the merged index and its filter, on equal priority the archive
+// that comes later in the list wins, same as mounting them one after another
+kres_err mount_archives(mount_set* ms, const vec<pair<string, int32_t>>& archives);
+
+kres_err mount_find(const mount_set& ms, id entry_id, mount_hit* out);
+kres_err mount_find(const mount_set& ms, const string& filename, mount_hit* out);
+
+// reads the highest priority version of an entry
+kres_err mount_read_entry(const mount_set& ms, id entry_id, entry* out);
+kres_err mount_read_entry(const mount_set& ms, const string& filename, entry* out);
+
+}  // namespace kres
+
+#endif  // KRES_MOUNT_H
@@ -0,0 +1,278 @@
+#include "paged.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "solid.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kres {
+
+uint64_t index_pages_offset(const header& h) {
+    uint64_t end = index_size(h) + h.user_section_size + root_area_size(h.flags);
+    return (end + KRES_INDEX_PAGE_SIZE - 1) / KRES_INDEX_PAGE_SIZE * KRES_INDEX_PAGE_SIZE;
+}
+
+kres_err set_paged_index(archive* ar, bool enabled) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (enabled) {
+        ar->header.flags |= KRES_FLAG_PAGED_INDEX | KRES_FLAG_SUPERBLOCK;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_PAGED_INDEX;
+    }
+
+    return make_header(ar);
+}
+
+void build_index_pages(const map<id, uint64_t>& table, byte_vec* pages, vec<index_fence>* fence) {
+    vec<pair<id, uint64_t>> sorted(table.begin(), table.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    uint64_t page_count = index_page_count(sorted.size());
+    pages->assign(page_count * KRES_INDEX_PAGE_SIZE, std::byte{0});
+    fence->resize(page_count);
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        uint64_t e_id = host_to_le64(sorted[i].first);
+        uint64_t offset = host_to_le64(sorted[i].second);
+        std::memcpy(pages->data() + i * 16, &e_id, 8);
+        std::memcpy(pages->data() + i * 16 + 8, &offset, 8);
+    }
+    for (uint64_t p = 0; p < page_count; p++) {
+        (*fence)[p].first = sorted[p * KRES_INDEX_PAGE_ENTRIES].first;
+        (*fence)[p].crc = crc32(pages->data() + p * KRES_INDEX_PAGE_SIZE, KRES_INDEX_PAGE_SIZE);
+    }
+}
+
+void decode_index_page(const std::byte* page, uint64_t count, map<id, uint64_t>* out) {
+    for (uint64_t i = 0; i < count; i++) {
+        (*out)[load_le64(page + i * 16)] = load_le64(page + i * 16 + 8);
+    }
+}
+
+static uint64_t page_entries(const header& h, uint64_t page) {
+    return std::min(KRES_INDEX_PAGE_ENTRIES, h.entry_count - page * KRES_INDEX_PAGE_ENTRIES);
+}
+
+// one page, from the mapping, the cache or the file, held keeps it alive while out points into it
+static kres_err load_page(const archive& ar,
+                          uint64_t page,
+                          const std::byte** out,
+                          std::shared_ptr<const byte_vec>* held) {
+    const header& h = ar.header;
+    uint64_t offset = index_pages_offset(h) + page * KRES_INDEX_PAGE_SIZE;
+
+    if (ar.index_pages && ar.index_pages->data) {
+        if ((page + 1) * KRES_INDEX_PAGE_SIZE > ar.index_pages->size) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        *out = ar.index_pages->data + page * KRES_INDEX_PAGE_SIZE;
+        return KRES_OK;
+    }
+
+    if (ar.cache) *held = ar.cache->find(offset);
+    if (!*held) {
+        file_reader r;
+        r.stats = ar.stats;
+        auto err = r.open(ar.path.c_str());
+        if (err != KRES_OK) return err;
+        err = r.seek(offset);
+        if (err != KRES_OK) return err;
+
+        auto data = std::make_shared<byte_vec>();
+        err = r.read_bytes(KRES_INDEX_PAGE_SIZE, data.get());
+        if (err != KRES_OK) return err;
+        if (crc32(data->data(), data->size()) != h.page_fence[page].crc) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+
+        if (ar.cache) ar.cache->insert(offset, data);
+        *held = std::move(data);
+    }
+
+    *out = (*held)->data();
+    return KRES_OK;
+}
+
+kres_err find_offset(const archive& ar, id entry_id, uint64_t* out) {
+    if (!out) return KRES_INVALID_STATE;
+
+    const header& h = ar.header;
+    if (!(h.flags & KRES_FLAG_PAGED_INDEX) || index_loaded(h)) {
+        auto it = h.offset_table.find(entry_id);
+        if (it == h.offset_table.end()) return KRES_ERROR_ENTRY_NOT_FOUND;
+        *out = it->second;
+        return KRES_OK;
+    }
+
+    // the last page starting at or before entry_id is the only one that can hold it
+    auto it = std::upper_bound(
+        h.page_fence.begin(), h.page_fence.end(), entry_id,
+        [](id e_id, const index_fence& f) { return e_id < f.first; });
+    if (it == h.page_fence.begin()) return KRES_ERROR_ENTRY_NOT_FOUND;
+    uint64_t page = static_cast<uint64_t>(it - h.page_fence.begin()) - 1;
+
+    const std::byte* data = nullptr;
+    std::shared_ptr<const byte_vec> held;
+    auto err = load_page(ar, page, &data, &held);
+    if (err != KRES_OK) return err;
+
+    uint64_t lo = 0;
+    uint64_t hi = page_entries(h, page);
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        id mid_id = load_le64(data + mid * 16);
+        if (mid_id == entry_id) {
+            *out = load_le64(data + mid * 16 + 8);
+            return KRES_OK;
+        }
+        if (mid_id < entry_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return KRES_ERROR_ENTRY_NOT_FOUND;
+}
+
+kres_err read_index(const archive& ar, map<id, uint64_t>* out) {
+    if (!out) return KRES_INVALID_STATE;
+
+    const header& h = ar.header;
+    if (index_loaded(h)) {
+        *out = h.offset_table;
+        return KRES_OK;
+    }
+    if (ar.path.empty() || h.page_fence.size() != index_page_count(h.entry_count)) {
+        return KRES_ERROR_INVALID_ARCHIVE;
+    }
+
+    file_reader r;
+    r.stats = ar.stats;
+    auto err = r.open(ar.path.c_str());
+    if (err != KRES_OK) return err;
+    err = r.seek(index_pages_offset(h));
+    if (err != KRES_OK) return err;
+
+    // pages come in a batch at a time, the file is read front to back once
+    constexpr uint64_t batch = 256;
+    byte_vec buf;
+    map<id, uint64_t> table;
+    table.reserve(h.entry_count);
+    for (uint64_t first = 0; first < h.page_fence.size(); first += batch) {
+        uint64_t count = std::min<uint64_t>(batch, h.page_fence.size() - first);
+        buf.resize(count * KRES_INDEX_PAGE_SIZE);
+        err = r.read_into(buf.data(), buf.size());
+        if (err != KRES_OK) return err;
+
+        for (uint64_t p = 0; p < count; p++) {
+            const std::byte* page = buf.data() + p * KRES_INDEX_PAGE_SIZE;
+            if (crc32(page, KRES_INDEX_PAGE_SIZE) != h.page_fence[first + p].crc) {
+                return KRES_ERROR_INVALID_ARCHIVE;
+            }
+            decode_index_page(page, page_entries(h, first + p), &table);
+        }
+    }
+
+    if (table.size() != h.entry_count) return KRES_ERROR_INVALID_ARCHIVE;  // duplicate ids
+    *out = std::move(table);
+    return KRES_OK;
+}
+
+kres_err load_index(archive* ar) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+    if (index_loaded(ar->header)) return KRES_OK;
+
+    map<id, uint64_t> table;
+    auto err = read_index(*ar, &table);
+    if (err != KRES_OK) return err;
+    ar->header.offset_table = std::move(table);
+    return KRES_OK;
+}
+
+kres_err full_index(const archive& ar,
+                    map<id, uint64_t>* storage,
+                    const map<id, uint64_t>** out) {
+    if (!storage || !out) return KRES_INVALID_STATE;
+    if (index_loaded(ar.header)) {
+        *out = &ar.header.offset_table;
+        return KRES_OK;
+    }
+
+    auto err = read_index(ar, storage);
+    if (err != KRES_OK) return err;
+    *out = storage;
+    return KRES_OK;
+}
+
+index_map::~index_map() { unmap_index_pages(this); }
+
+kres_err map_index_pages(const archive& ar, index_map* out) {
+    if (!out) return KRES_INVALID_STATE;
+    if (ar.path.empty() || !(ar.header.flags & KRES_FLAG_PAGED_INDEX)) {
+        return KRES_ERROR_INVALID_ARCHIVE;
+    }
+    unmap_index_pages(out);
+
+    uint64_t offset = index_pages_offset(ar.header);
+    uint64_t size = ar.header.page_fence.size() * KRES_INDEX_PAGE_SIZE;
+    if (size == 0) return KRES_OK;
+
+#ifdef _WIN32
+    file_reader r;
+    auto err = r.open(ar.path.c_str());
+    if (err != KRES_OK) return err;
+    err = r.seek(offset);
+    if (err != KRES_OK) return err;
+    err = r.read_bytes(size, &out->owned);
+    if (err != KRES_OK) return err;
+    out->data = out->owned.data();
+#else
+    // pages are 4 KB aligned in the file, the os page can be bigger (16 KB, 64 KB), so the mapping
+    // starts at the os page holding the first one
+    static const uint64_t os_page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t aligned = offset & ~(os_page - 1);
+    out->fd = ::open(ar.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (out->fd < 0) return KRES_ERROR_FAILED_IO;
+    struct stat st {};
+    if (::fstat(out->fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < offset + size) {
+        unmap_index_pages(out);
+        return KRES_ERROR_INVALID_ARCHIVE;  // touching the missing tail would fault
+    }
+    uint64_t map_size = size + (offset - aligned);
+    void* m =
+        ::mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, out->fd, static_cast<off_t>(aligned));
+    if (m == MAP_FAILED) {
+        unmap_index_pages(out);
+        return KRES_ERROR_FAILED_IO;
+    }
+    out->map = m;
+    out->map_size = map_size;
+    out->data = static_cast<const std::byte*>(m) + (offset - aligned);
+#endif
+    out->size = size;
+    return KRES_OK;
+}
+
+void unmap_index_pages(index_map* m) {
+#ifdef _WIN32
+    m->owned.clear();
+#else
+    if (m->map) ::munmap(m->map, m->map_size);
+    if (m->fd >= 0) ::close(m->fd);
+    m->fd = -1;
+    m->map = nullptr;
+    m->map_size = 0;
+#endif
+    m->data = nullptr;
+    m->size = 0;
+}
+
+}  // namespace kres
@@ -0,0 +1,77 @@
+#ifndef KRES_PAGED_H
+#define KRES_PAGED_H
+
+#include "main.h"
+
+namespace kres {
+
+// archives with KRES_FLAG_PAGED_INDEX (always together with the superblock) don't store a flat
+// offset table, the (id, offset) pairs are sorted by id and cut into fixed size pages that follow
+// the user section on a page boundary, the index itself only holds the fence, the first id and a
+// crc32 of every page, so opening reads about 12 bytes per 256 entries instead of 16 per entry
+//
+// preloading leaves header::offset_table empty, lookups binary search the fence and then the page,
+// pages come from the index_map attached through archive::index_pages, from archive::cache
+// (the same block_cache solid blocks use) or straight from the file, one read per lookup, pages
+// read from the file are checked against their crc, mapped ones are trusted
+
+constexpr uint64_t KRES_INDEX_PAGE_SIZE = 4096;
+constexpr uint64_t KRES_INDEX_PAGE_ENTRIES = KRES_INDEX_PAGE_SIZE / 16;
+
+constexpr uint64_t index_page_count(uint64_t entry_count) {
+    return (entry_count + KRES_INDEX_PAGE_ENTRIES - 1) / KRES_INDEX_PAGE_ENTRIES;
+}
+
+// where the first page starts in the archive file
+uint64_t index_pages_offset(const header& h);
+
+// false for paged archives that were opened with just their fence
+inline bool index_loaded(const header& h) { return h.offset_table.size() == h.entry_count; }
+
+// switches an archive being built to a paged index, the header is regenerated
+kres_err set_paged_index(archive* ar, bool enabled);
+
+// sorts table into zero padded pages and fills in their fence
+void build_index_pages(const map<id, uint64_t>& table, byte_vec* pages, vec<index_fence>* fence);
+// adds the count pairs of one page to out
+void decode_index_page(const std::byte* page, uint64_t count, map<id, uint64_t>* out);
+
+// offset of an entry, through the pages when the offset table isn't loaded,
+// KRES_ERROR_ENTRY_NOT_FOUND when it isn't in the archive
+kres_err find_offset(const archive& ar, id entry_id, uint64_t* out);
+
+// the whole offset table, read page by page from the file of a preloaded archive
+kres_err read_index(const archive& ar, map<id, uint64_t>* out);
+// brings header.offset_table in, no-op when already there
+kres_err load_index(archive* ar);
+// for code walking every entry, out points at the header's own table when it is loaded, otherwise
+// the pages are read into storage
+kres_err full_index(const archive& ar,
+                    map<id, uint64_t>* storage,
+                    const map<id, uint64_t>** out);
+
+// read only mapping of the page region, pages are then faulted in by the os as lookups touch them
+// (on windows they are read in up front instead)
+struct index_map {
+    const std::byte* data = nullptr;
+    uint64_t size = 0;
+#ifdef _WIN32
+    byte_vec owned;
+#else
+    int fd = -1;
+    void* map = nullptr;  // the whole mapping, starting at or before data
+    uint64_t map_size = 0;
+#endif
+
+    index_map() = default;
+    index_map(const index_map&) = delete;
+    index_map& operator=(const index_map&) = delete;
+    ~index_map();
+};
+
+kres_err map_index_pages(const archive& ar, index_map* out);
+void unmap_index_pages(index_map* m);
+
+}  // namespace kres
+
+#endif  // KRES_PAGED_H
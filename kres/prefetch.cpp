@@ -0,0 +1,164 @@
+#include "prefetch.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "paged.h"
+#include "volume.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace kres {
+
+static void sort_offsets(const map<id, uint64_t>& table, prefetcher* out) {
+    out->offset_table = &table;
+    out->offsets.clear();
+    out->offsets.reserve(table.size());
+    for (const auto& [e_id, offset] : table) out->offsets.push_back(offset);
+    std::sort(out->offsets.begin(), out->offsets.end());
+}
+
+prefetcher::~prefetcher() { close_prefetcher(this); }
+
+kres_err open_prefetcher(const archive& ar, prefetcher* out) {
+    if (!out) return KRES_INVALID_STATE;
+    if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+    close_prefetcher(out);
+
+    std::error_code ec;
+    out->end = std::filesystem::file_size(ar.path, ec);
+    if (ec) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+
+    for (size_t v = 1; v < ar.header.volume_sizes.size(); v++) {
+        out->volume_ends.push_back(ar.header.volume_sizes[v]);
+#ifndef _WIN32
+        out->volume_fds.push_back(::open(volume_path(ar.path, v).c_str(), O_RDONLY | O_CLOEXEC));
+        if (out->volume_fds.back() < 0) return KRES_ERROR_FAILED_IO;
+#endif
+    }
+
+#ifndef _WIN32
+    out->fd = ::open(ar.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (out->fd < 0) return KRES_ERROR_FAILED_IO;
+#endif
+
+    const map<id, uint64_t>* table = nullptr;
+    auto err = full_index(ar, &out->owned_table, &table);
+    if (err != KRES_OK) return err;
+    sort_offsets(*table, out);
+    return KRES_OK;
+}
+
+kres_err open_prefetcher(const archive_view& v, prefetcher* out) {
+    if (!out) return KRES_INVALID_STATE;
+    close_prefetcher(out);
+
+    out->base = v.data.data();
+    out->end = v.data.size();
+    sort_offsets(v.offset_table, out);
+    return KRES_OK;
+}
+
+void close_prefetcher(prefetcher* p) {
+#ifndef _WIN32
+    if (p->fd >= 0) ::close(p->fd);
+    for (int fd : p->volume_fds) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+    p->fd = -1;
+    p->volume_fds.clear();
+    p->volume_ends.clear();
+    p->base = nullptr;
+    p->offset_table = nullptr;
+    p->owned_table.clear();
+    p->offsets.clear();
+}
+
+#ifndef _WIN32
+// macos has no posix_fadvise, F_RDADVISE is its read ahead hint (with an int length), anything
+// else without either just skips the hint
+static kres_err advise_fd(int fd, uint64_t offset, uint64_t length) {
+#if defined(POSIX_FADV_WILLNEED)
+    int rc = ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                             POSIX_FADV_WILLNEED);
+    return rc == 0 ? KRES_OK : KRES_ERROR_FAILED_IO;
+#elif defined(F_RDADVISE)
+    radvisory ra{};
+    ra.ra_offset = static_cast<off_t>(offset);
+    ra.ra_count = static_cast<int>(std::min<uint64_t>(length, INT_MAX));
+    return ::fcntl(fd, F_RDADVISE, &ra) == 0 ? KRES_OK : KRES_ERROR_FAILED_IO;
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return KRES_OK;
+#endif
+}
+#endif
+
+// on windows there's no cheap equivalent for files opened through iostreams, hints are a no-op
+static kres_err advise(const prefetcher& p, uint64_t start, uint64_t end) {
+#ifndef _WIN32
+    if (offset_volume(start) > 0) {
+        return advise_fd(p.volume_fds[offset_volume(start) - 1], offset_local(start), end - start);
+    }
+    if (p.base) {
+        // madvise wants page aligned addresses
+        static const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        auto addr = reinterpret_cast<uintptr_t>(p.base) + start;
+        uintptr_t aligned = addr & ~(page - 1);
+        int rc = ::madvise(reinterpret_cast<void*>(aligned), end - start + (addr - aligned),
+                           MADV_WILLNEED);
+        // memory that isn't a mapping (embedded archives) simply has nothing to prefetch
+        return rc == 0 || errno == EINVAL || errno == ENOMEM ? KRES_OK : KRES_ERROR_FAILED_IO;
+    }
+    if (p.fd >= 0) return advise_fd(p.fd, start, end - start);
+#endif
+    (void)p;
+    (void)start;
+    (void)end;
+    return KRES_OK;
+}
+
+kres_err prefetch(const prefetcher& p, std::span<const id> ids) {
+    if (!p.offset_table) return KRES_INVALID_STATE;
+    trace_scope trace("prefetch", ids.size());
+
+    vec<pair<uint64_t, uint64_t>> ranges;
+    ranges.reserve(ids.size());
+    for (id e_id : ids) {
+        auto it = p.offset_table->find(e_id);
+        if (it == p.offset_table->end()) continue;
+
+        // a record runs up to the next one in the same file, or to the end of that file
+        uint64_t start = it->second;
+        uint64_t volume = offset_volume(start);
+        if (volume > p.volume_ends.size()) continue;
+        uint64_t file_end = volume == 0 ? p.end : volume_offset(volume, p.volume_ends[volume - 1]);
+
+        auto next = std::upper_bound(p.offsets.begin(), p.offsets.end(), start);
+        ranges.emplace_back(start, next == p.offsets.end() ? file_end : std::min(*next, file_end));
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    size_t i = 0;
+    while (i < ranges.size()) {
+        uint64_t start = ranges[i].first;
+        uint64_t end = ranges[i].second;
+        for (i++; i < ranges.size() && ranges[i].first <= end; i++) {
+            end = std::max(end, ranges[i].second);
+        }
+
+        auto err = advise(p, start, end);
+        if (err != KRES_OK) return err;
+    }
+
+    return KRES_OK;
+}
+
+}  // namespace kres
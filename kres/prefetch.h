@@ -0,0 +1,46 @@
+#ifndef KRES_PREFETCH_H
+#define KRES_PREFETCH_H
+
+#include <span>
+
+#include "main.h"
+#include "view.h"
+
+namespace kres {
+
+// turns entry ids into byte ranges and asks the kernel to start reading them in the background,
+// posix_fadvise(WILLNEED) for archive files and madvise(WILLNEED) for in-memory views (mmap), so a
+// later read_entry on those ids is served from the page cache
+//
+// records don't store their own length up front, so opening a prefetcher sorts the offset table
+// once, a record ends where the next one starts, the archive or view has to outlive the prefetcher
+struct prefetcher {
+    const map<id, uint64_t>* offset_table = nullptr;
+    map<id, uint64_t> owned_table;  // paged archives, their pages are read in once
+    vec<uint64_t> offsets;  // sorted record starts
+    uint64_t end = 0;       // file / view size
+
+    int fd = -1;                        // archive files
+    const std::byte* base = nullptr;    // views
+
+    // split archives, index v - 1 holds volume v, see volume.h
+    vec<int> volume_fds;
+    vec<uint64_t> volume_ends;
+
+    prefetcher() = default;
+    prefetcher(const prefetcher&) = delete;
+    prefetcher& operator=(const prefetcher&) = delete;
+    ~prefetcher();
+};
+
+kres_err open_prefetcher(const archive& ar, prefetcher* out);
+kres_err open_prefetcher(const archive_view& v, prefetcher* out);
+void close_prefetcher(prefetcher* p);
+
+// returns right after the hints are issued, unknown ids are skipped, neighbouring records are
+// merged into a single hint
+kres_err prefetch(const prefetcher& p, std::span<const id> ids);
+
+}  // namespace kres
+
+#endif  // KRES_PREFETCH_H
@@ -0,0 +1,164 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "attributes.h"
+#include "build_cache.h"
+#include "paged.h"
+#include "volume.h"
+
+namespace kres {
+
+kres_err save_access_profile(access_recorder* rec, const string& filename) {
+    if (!rec) return KRES_INVALID_STATE;
+
+    byte_vec data;
+    byte_writer writer;
+    writer.buffer = &data;
+    {
+        std::lock_guard lock(rec->mutex);
+        data.reserve(rec->order.size() * 8);
+        for (id e_id : rec->order) writer.write_u64(e_id);
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return KRES_ERROR_FAILED_IO;
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    return file.good() ? KRES_OK : KRES_ERROR_FAILED_IO;
+}
+
+kres_err load_access_profile(const string& filename, vec<id>* out) {
+    if (!out) return KRES_INVALID_STATE;
+    if (!std::filesystem::is_regular_file(filename)) return KRES_ERROR_INVALID_INPUT_FILE;
+
+    uint64_t size = std::filesystem::file_size(filename);
+    if (size % 8 != 0) return KRES_ERROR_INVALID_INPUT_FILE;
+
+    file_reader r;
+    auto err = r.open(filename.c_str());
+    if (err != KRES_OK) return err;
+
+    out->clear();
+    out->reserve(size / 8);
+    for (uint64_t i = 0; i < size / 8; i++) {
+        id e_id;
+        err = r.read_u64(&e_id);
+        if (err != KRES_OK) return err;
+        out->push_back(e_id);
+    }
+    return KRES_OK;
+}
+
+kres_err reorder_entries(archive* ar, const vec<id>& order) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    map<id, size_t> rank;
+    rank.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++) rank.try_emplace(order[i], i);
+
+    // rank of every entry once, instead of hashing filenames inside the comparator
+    vec<pair<size_t, size_t>> keyed;  // (rank, original index)
+    keyed.reserve(ar->entries.size());
+    for (size_t i = 0; i < ar->entries.size(); i++) {
+        auto it = rank.find(generate_id(ar->entries[i].filename));
+        keyed.emplace_back(it == rank.end() ? order.size() : it->second, i);
+    }
+    std::stable_sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    vec<entry> sorted;
+    sorted.reserve(ar->entries.size());
+    for (const auto& [r, i] : keyed) sorted.push_back(std::move(ar->entries[i]));
+    ar->entries = std::move(sorted);
+
+    return make_header(ar);
+}
+
+kres_err repack_archive(const archive& src, const vec<id>& order, const string& filename) {
+    if (src.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+    if (src.path == filename) return KRES_INVALID_STATE;  // would truncate what we read from
+
+    // one reader per volume shared by every payload source in it, serialization calls them one
+    // after another
+    vec<std::shared_ptr<file_reader>> readers(std::max<size_t>(src.header.volume_sizes.size(), 1));
+
+    map<id, uint64_t> storage;
+    const map<id, uint64_t>* table = nullptr;
+    auto err = full_index(src, &storage, &table);
+    if (err != KRES_OK) return err;
+
+    map<id, file_stat> metas;  // kept, so the next incremental build still sees every file
+    err = load_source_meta(src, &metas);
+    if (err != KRES_OK) return err;
+    attribute_table attributes;
+    err = load_attributes(src, &attributes);
+    if (err != KRES_OK) return err;
+
+    vec<pair<uint64_t, id>> records;
+    records.reserve(table->size());
+    for (const auto& [e_id, offset] : *table) records.emplace_back(offset, e_id);
+    std::sort(records.begin(), records.end());
+
+    archive out = init_archive();
+    out.header.flags = src.header.flags;
+    out.header.volume_size_cap = src.header.volume_size_cap;
+    out.header.attribute_columns = src.header.attribute_columns;
+    err = read_user_section(src, &out.header.user_section);  // may still be on disk
+    if (err != KRES_OK) return err;
+    out.header.user_section_size = src.header.user_section_size;
+    out.entries.reserve(records.size());
+
+    for (const auto& [encoded, e_id] : records) {
+        uint64_t volume = offset_volume(encoded);
+        if (volume >= readers.size()) return KRES_ERROR_INVALID_ARCHIVE;
+        if (!readers[volume]) {
+            readers[volume] = std::make_shared<file_reader>();
+            err = readers[volume]->open(volume_path(src.path, volume).c_str());
+            if (err != KRES_OK) return err;
+        }
+
+        const auto& r = readers[volume];
+        uint64_t offset = offset_local(encoded);
+        entry e;
+        err = r->seek(offset);
+        if (err != KRES_OK) return err;
+        err = r->read_u32(&e.filename_len);
+        if (err != KRES_OK) return err;
+        err = r->read_string(&e.filename);
+        if (err != KRES_OK) return err;
+        err = r->read_u32(&e.crc32);
+        if (err != KRES_OK) return err;
+        err = r->read_u64(&e.size);
+        if (err != KRES_OK) return err;
+
+        auto meta = metas.find(e_id);
+        if (meta != metas.end()) e.source_mtime = meta->second.mtime;
+        size_t row = attributes.row(e_id);
+        for (size_t c = 0; row != SIZE_MAX && c < attributes.columns.size(); c++) {
+            auto u32 = attributes.u32(c);
+            e.attributes.push_back(u32.empty() ? attributes.u64(c)[row] : u32[row]);
+        }
+
+        uint64_t data_offset = offset + 4 + e.filename_len + 1 + 4 + 8;
+        uint32_t expected_crc = e.crc32;
+        e.source = [r, data_offset, expected_crc](std::span<std::byte> data) {
+            auto err = r->seek(data_offset);
+            if (err != KRES_OK) return err;
+            err = r->read_into(data.data(), data.size());
+            if (err != KRES_OK) return err;
+            if (crc32(data.data(), data.size()) != expected_crc) return KRES_ERROR_ENTRY_CORRUPTED;
+            return KRES_OK;
+        };
+        out.entries.push_back(std::move(e));
+    }
+
+    err = reorder_entries(&out, order);
+    if (err != KRES_OK) return err;
+
+    return serialize_archive(out, filename);
+}
+
+}  // namespace kres
@@ -0,0 +1,39 @@
+#ifndef KRES_PROFILE_H
+#define KRES_PROFILE_H
+
+#include <mutex>
+#include <unordered_set>
+
+#include "main.h"
+
+namespace kres {
+
+// remembers the order entries are first read in, attach one through archive::recorder during a cold
+// start (or any other workload worth optimizing for), save it, then repack with it so those reads
+// become close to sequential
+struct access_recorder {
+    std::mutex mutex;
+    vec<id> order;
+    std::unordered_set<id> seen;
+
+    void record(id entry_id) {
+        std::lock_guard lock(mutex);
+        if (seen.insert(entry_id).second) order.push_back(entry_id);
+    }
+};
+
+// profiles are stored as a plain list of little endian ids
+kres_err save_access_profile(access_recorder* rec, const string& filename);
+kres_err load_access_profile(const string& filename, vec<id>* out);
+
+// moves entries listed in order to the front, in that order, everything else keeps its relative
+// position after them, the header is regenerated
+kres_err reorder_entries(archive* ar, const vec<id>& order);
+
+// rewrites a preloaded archive into filename with its records laid out by order, payloads are
+// streamed from the source file one at a time and checked against their crc on the way
+kres_err repack_archive(const archive& src, const vec<id>& order, const string& filename);
+
+}  // namespace kres
+
+#endif  // KRES_PROFILE_H
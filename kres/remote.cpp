@@ -0,0 +1,338 @@
+#include "remote.h"
+
+#include <algorithm>
+
+#include "io.h"
+#include "volume.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace kres {
+
+remote_archive::~remote_archive() { close_remote(this); }
+
+remote_server::~remote_server() { close_server(this); }
+
+#ifndef _WIN32
+// longest name either end accepts, names are paths so this is already generous
+constexpr uint32_t remote_max_name = 64 * 1024;
+
+// MSG_NOSIGNAL so a daemon that went away shows up as an error instead of a SIGPIPE in the client,
+// macos and the bsds don't have it and set SO_NOSIGPIPE on the socket instead
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+kres_err connect_remote(const string& socket_path, remote_archive* out) {
+    if (!out) return KRES_INVALID_STATE;
+    close_remote(out);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) return KRES_ERROR_INVALID_INPUT_FILE;
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+#ifdef SOCK_CLOEXEC
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#else
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    if (fd < 0) return KRES_ERROR_FAILED_IO;
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    if (::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one)) != 0) {
+        ::close(fd);
+        return KRES_ERROR_FAILED_IO;
+    }
+#endif
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return KRES_ERROR_FAILED_IO;
+    }
+
+    out->fd = fd;
+    return KRES_OK;
+}
+
+void close_remote(remote_archive* r) {
+    if (r->fd >= 0) ::close(r->fd);
+    r->fd = -1;
+}
+
+static kres_err send_request(int fd, const byte_vec& req) {
+    size_t done = 0;
+    while (done < req.size()) {
+        ssize_t n = ::send(fd, req.data() + done, req.size() - done, send_flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return KRES_ERROR_FAILED_IO;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return KRES_OK;
+}
+
+static kres_err read_response(int fd, uint64_t max_size, entry* out) {
+    std::byte buf[12];
+    auto err = read_all(fd, buf, 4);
+    if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+    auto status = static_cast<kres_err>(static_cast<int32_t>(load_le32(buf)));
+    if (status != KRES_OK) return status;
+
+    err = read_all(fd, buf, 4);
+    if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+    out->filename_len = load_le32(buf);
+    if (out->filename_len > remote_max_name) return KRES_ERROR_INVALID_ARCHIVE;
+    uint64_t name_size = uint64_t{out->filename_len} + 1;
+    out->filename.resize(name_size);
+    err = read_all(fd, out->filename.data(), name_size);
+    if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+    out->filename.resize(out->filename_len);
+
+    err = read_all(fd, buf, 12);
+    if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+    out->crc32 = load_le32(buf);
+    out->size = load_le64(buf + 4);
+    if (out->size > max_size) return KRES_ERROR_INVALID_ARCHIVE;
+
+    out->data.resize(out->size);
+    err = read_all(fd, out->data.data(), out->size);
+    return err == KRES_OK ? KRES_OK : KRES_ERROR_FAILED_IO;
+}
+
+kres_err read_entry(const remote_archive& r, id entry_id, entry* out) {
+    if (r.fd < 0 || !out) return KRES_INVALID_STATE;
+
+    byte_vec req;
+    byte_writer writer;
+    writer.buffer = &req;
+    req.push_back(std::byte{REMOTE_GET_ID});
+    writer.write_u64(entry_id);
+
+    auto err = send_request(r.fd, req);
+    if (err != KRES_OK) return err;
+    return read_response(r.fd, r.max_size, out);
+}
+
+kres_err read_entry(const remote_archive& r, const string& filename, entry* out) {
+    if (r.fd < 0 || !out) return KRES_INVALID_STATE;
+
+    byte_vec req;
+    byte_writer writer;
+    writer.buffer = &req;
+    req.push_back(std::byte{REMOTE_GET_NAME});
+    writer.write_u32(static_cast<uint32_t>(filename.size()));
+    writer.write_raw(filename.data(), filename.size());
+
+    auto err = send_request(r.fd, req);
+    if (err != KRES_OK) return err;
+    return read_response(r.fd, r.max_size, out);
+}
+
+kres_err read_range(const remote_archive& r,
+                    id entry_id,
+                    uint64_t offset,
+                    uint64_t length,
+                    byte_vec* out) {
+    if (r.fd < 0 || !out) return KRES_INVALID_STATE;
+
+    byte_vec req;
+    byte_writer writer;
+    writer.buffer = &req;
+    req.push_back(std::byte{REMOTE_GET_RANGE});
+    writer.write_u64(entry_id);
+    writer.write_u64(offset);
+    writer.write_u64(length);
+
+    auto err = send_request(r.fd, req);
+    if (err != KRES_OK) return err;
+
+    entry e;
+    err = read_response(r.fd, std::min(length, r.max_size), &e);
+    if (err != KRES_OK) return err;
+    *out = std::move(e.data);
+    return KRES_OK;
+}
+
+kres_err open_server(const vec<string>& archives, remote_server* out) {
+    if (!out) return KRES_INVALID_STATE;
+    close_server(out);
+
+    vec<pair<string, int32_t>> layers;
+    layers.reserve(archives.size());
+    for (size_t i = 0; i < archives.size(); i++) {
+        layers.emplace_back(archives[i], static_cast<int32_t>(i));
+    }
+    auto err = mount_archives(&out->ms, layers);
+    if (err != KRES_OK) return err;
+
+    out->fds.resize(out->ms.layers.size());
+    for (size_t l = 0; l < out->ms.layers.size(); l++) {
+        const archive& layer = out->ms.layers[l].ar;
+        size_t volumes = std::max<size_t>(layer.header.volume_sizes.size(), 1);
+        for (size_t v = 0; v < volumes; v++) {
+            out->fds[l].push_back(::open(volume_path(layer.path, v).c_str(), O_RDONLY | O_CLOEXEC));
+            if (out->fds[l].back() < 0) {
+                close_server(out);
+                return KRES_ERROR_FAILED_IO;
+            }
+        }
+    }
+    return KRES_OK;
+}
+
+void close_server(remote_server* s) {
+    for (const auto& layer : s->fds) {
+        for (int fd : layer) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+    s->fds.clear();
+    s->ms = mount_set{};
+}
+
+static kres_err send_status(int conn, kres_err status) {
+    uint32_t raw = host_to_le32(static_cast<uint32_t>(status));
+    iovec iov{&raw, 4};
+    return write_all(conn, &iov, 1);
+}
+
+// the record prefix is sent as stored, the payload (or the requested part of it) follows straight
+// from the archive file, only transport errors are returned, lookup errors go to the client
+static kres_err send_entry(const remote_server& s,
+                           int conn,
+                           id entry_id,
+                           uint64_t range_offset,
+                           uint64_t range_length) {
+    mount_hit hit;
+    auto status = mount_find(s.ms, entry_id, &hit);
+    if (status != KRES_OK) return send_status(conn, status);
+
+    trace_scope trace("entry_read", entry_id);
+    const auto& volumes = s.fds[hit.layer];
+    if (offset_volume(hit.offset) >= volumes.size()) {
+        return send_status(conn, KRES_ERROR_INVALID_ARCHIVE);
+    }
+    int fd = volumes[offset_volume(hit.offset)];
+    uint64_t record = offset_local(hit.offset);
+    std::byte len_buf[4];
+    if (pread_all(fd, len_buf, 4, record) != KRES_OK) {
+        return send_status(conn, KRES_ERROR_INVALID_ARCHIVE);
+    }
+    uint64_t prefix_size = 4 + uint64_t{load_le32(len_buf)} + 1 + 4 + 8;
+
+    // status + prefix in one buffer
+    byte_vec head(4 + prefix_size);
+    uint32_t ok = host_to_le32(KRES_OK);
+    std::memcpy(head.data(), &ok, 4);
+    if (pread_all(fd, head.data() + 4, prefix_size, record) != KRES_OK) {
+        return send_status(conn, KRES_ERROR_INVALID_ARCHIVE);
+    }
+
+    uint64_t size = load_le64(head.data() + head.size() - 8);
+    uint64_t offset = std::min(range_offset, size);
+    uint64_t length = std::min(range_length, size - offset);
+    uint64_t sent_size = host_to_le64(length);
+    std::memcpy(head.data() + head.size() - 8, &sent_size, 8);
+
+    iovec iov{head.data(), head.size()};
+    auto err = write_all(conn, &iov, 1);
+    if (err != KRES_OK) return err;
+
+    uint64_t data_offset = record + prefix_size + offset;
+#ifdef __linux__
+    return send_range(fd, conn, data_offset, length);
+#else
+    byte_vec buf(std::min<uint64_t>(length, 1024 * 1024));
+    while (length > 0) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(length, buf.size()));
+        err = pread_all(fd, buf.data(), n, data_offset);
+        if (err != KRES_OK) return err;
+        iovec chunk{buf.data(), n};
+        err = write_all(conn, &chunk, 1);
+        if (err != KRES_OK) return err;
+        data_offset += n;
+        length -= n;
+    }
+    return KRES_OK;
+#endif
+}
+
+kres_err serve_connection(const remote_server& s, int conn) {
+    for (;;) {
+        uint8_t op;
+        auto err = read_all(conn, &op, 1);
+        if (err == KRES_ERROR_EOF) return KRES_OK;  // client is done
+        if (err != KRES_OK) return err;
+
+        std::byte buf[24];
+        id entry_id = 0;
+        uint64_t range_offset = 0;
+        uint64_t range_length = UINT64_MAX;
+
+        switch (op) {
+            case REMOTE_GET_NAME: {
+                err = read_all(conn, buf, 4);
+                if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+                uint32_t len = load_le32(buf);
+                if (len > remote_max_name) {
+                    send_status(conn, KRES_ERROR_BUFFER_OVERFLOW);
+                    return KRES_ERROR_BUFFER_OVERFLOW;
+                }
+                string name(len, '\0');
+                err = read_all(conn, name.data(), len);
+                if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+                entry_id = generate_id(name);
+                break;
+            }
+            case REMOTE_GET_ID:
+                err = read_all(conn, buf, 8);
+                if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+                entry_id = load_le64(buf);
+                break;
+            case REMOTE_GET_RANGE:
+                err = read_all(conn, buf, 24);
+                if (err != KRES_OK) return KRES_ERROR_FAILED_IO;
+                entry_id = load_le64(buf);
+                range_offset = load_le64(buf + 8);
+                range_length = load_le64(buf + 16);
+                break;
+            default:
+                // no way to tell where the next request starts, so the connection ends here
+                send_status(conn, KRES_INVALID_STATE);
+                return KRES_INVALID_STATE;
+        }
+
+        err = send_entry(s, conn, entry_id, range_offset, range_length);
+        if (err != KRES_OK) return err;
+    }
+}
+#else
+// unix domain sockets and sendfile only, windows gets the api but every call fails
+kres_err connect_remote(const string&, remote_archive*) { return KRES_ERROR_FAILED_IO; }
+void close_remote(remote_archive* r) { r->fd = -1; }
+kres_err read_entry(const remote_archive&, id, entry*) { return KRES_ERROR_FAILED_IO; }
+kres_err read_entry(const remote_archive&, const string&, entry*) { return KRES_ERROR_FAILED_IO; }
+kres_err read_range(const remote_archive&, id, uint64_t, uint64_t, byte_vec*) {
+    return KRES_ERROR_FAILED_IO;
+}
+kres_err open_server(const vec<string>&, remote_server*) { return KRES_ERROR_FAILED_IO; }
+void close_server(remote_server* s) {
+    s->fds.clear();
+    s->ms = mount_set{};
+}
+kres_err serve_connection(const remote_server&, int) { return KRES_ERROR_FAILED_IO; }
+#endif
+
+}  // namespace kres
@@ -0,0 +1,70 @@
+#ifndef KRES_REMOTE_H
+#define KRES_REMOTE_H
+
+#include "mount.h"
+
+namespace kres {
+
+// a long running process (kres_serve) keeps archives mounted with their index resident and hands
+// entries out over a unix domain socket, clients skip opening and parsing headers altogether
+//
+// wire format, little endian, one request and its response at a time per connection:
+//   request:  u8 op, then REMOTE_GET_NAME: u32 len + name bytes
+//                         REMOTE_GET_ID: u64 id
+//                         REMOTE_GET_RANGE: u64 id, u64 offset, u64 length
+//   response: i32 kres_err, on KRES_OK followed by the record prefix as stored in the archive
+//             (u32 filename_len, filename + \0, u32 crc32, u64 size) and size payload bytes, for
+//             ranges size is the length actually sent while crc32 stays the one of the whole entry
+enum remote_op : uint8_t {
+    REMOTE_GET_NAME = 1,
+    REMOTE_GET_ID = 2,
+    REMOTE_GET_RANGE = 3,
+};
+
+// client end of a connection, requests are synchronous so use one connection per thread. lengths
+// in a response are checked before anything is allocated for them, a name over 64 KiB or a payload
+// over max_size fails with KRES_ERROR_INVALID_ARCHIVE and leaves the connection unusable
+struct remote_archive {
+    int fd = -1;
+    uint64_t max_size = uint64_t{1} << 32;
+
+    remote_archive() = default;
+    remote_archive(const remote_archive&) = delete;
+    remote_archive& operator=(const remote_archive&) = delete;
+    ~remote_archive();
+};
+
+kres_err connect_remote(const string& socket_path, remote_archive* out);
+void close_remote(remote_archive* r);
+
+kres_err read_entry(const remote_archive& r, id entry_id, entry* out);
+kres_err read_entry(const remote_archive& r, const string& filename, entry* out);
+// length bytes of the payload starting at offset, fewer when that runs past the end of the entry
+kres_err read_range(const remote_archive& r,
+                    id entry_id,
+                    uint64_t offset,
+                    uint64_t length,
+                    byte_vec* out);
+
+// server side, archives are mounted like mount_archives (later ones shadow earlier ones) and every
+// layer's files are kept open so payloads can be sent from it directly
+struct remote_server {
+    mount_set ms;
+    vec<vec<int>> fds;  // per mount layer, one per volume file (just the archive when not split)
+
+    remote_server() = default;
+    remote_server(const remote_server&) = delete;
+    remote_server& operator=(const remote_server&) = delete;
+    ~remote_server();
+};
+
+kres_err open_server(const vec<string>& archives, remote_server* out);
+void close_server(remote_server* s);
+
+// answers requests on conn until the client hangs up (KRES_OK) or the connection breaks, payloads
+// go out with sendfile on linux, safe to run for many connections at once
+kres_err serve_connection(const remote_server& s, int conn);
+
+}  // namespace kres
+
+#endif  // KRES_REMOTE_H
@@ -0,0 +1,99 @@
+#include "solid.h"
+#include "volume.h"
+
+#include <algorithm>
+
+namespace kres {
+
+kres_err set_solid_blocks(archive* ar, bool enabled, uint64_t entry_limit, uint64_t block_size) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (enabled) {
+        ar->header.flags |= KRES_FLAG_SOLID;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_SOLID;
+    }
+    ar->header.solid_entry_limit = entry_limit;
+    ar->header.solid_block_size = block_size;
+
+    return make_header(ar);
+}
+
+const solid_block* find_block(const header& h, uint64_t offset) {
+    if (!(h.flags & KRES_FLAG_SOLID) || h.block_table.empty()) return nullptr;
+
+    // blocks are laid out front to back, so the table is sorted by offset
+    auto it = std::upper_bound(
+        h.block_table.begin(), h.block_table.end(), offset,
+        [](uint64_t off, const solid_block& block) { return off < block.offset; });
+    if (it == h.block_table.begin()) return nullptr;
+    --it;
+    return offset - it->offset < it->size ? &*it : nullptr;
+}
+
+static kres_err load_block(const archive& ar,
+                           const solid_block& block,
+                           reader_stats* stats,
+                           std::shared_ptr<const byte_vec>* out) {
+    if (ar.cache) {
+        *out = ar.cache->find(block.offset);
+        if (stats) stats->record_cache(*out != nullptr);
+        if (*out) return KRES_OK;
+    }
+
+    file_reader r;
+    r.stats = stats;
+    auto err = r.open(volume_path(ar.path, offset_volume(block.offset)).c_str());
+    if (err != KRES_OK) return err;
+    err = r.seek(offset_local(block.offset));
+    if (err != KRES_OK) return err;
+
+    auto data = std::make_shared<byte_vec>();
+    err = r.read_bytes(block.size, data.get());
+    if (err != KRES_OK) return err;
+
+    if (ar.cache) ar.cache->insert(block.offset, data);
+    *out = std::move(data);
+    return KRES_OK;
+}
+
+kres_err read_block_entry(const archive& ar,
+                          const solid_block& block,
+                          uint64_t offset,
+                          entry* out) {
+    return read_block_entry(ar, block, offset, out, ar.stats);
+}
+
+kres_err read_block_entry(const archive& ar,
+                          const solid_block& block,
+                          uint64_t offset,
+                          entry* out,
+                          reader_stats* stats) {
+    if (!out || offset < block.offset || offset - block.offset >= block.size) {
+        return KRES_INVALID_STATE;
+    }
+
+    std::shared_ptr<const byte_vec> data;
+    auto err = load_block(ar, block, stats, &data);
+    if (err != KRES_OK) return err;
+
+    byte_reader reader;
+    reader.buffer = data.get();
+    reader.pos = offset - block.offset;
+
+    err = reader.read_u32(&out->filename_len);
+    if (err != KRES_OK) return err;
+    err = reader.read_string(&out->filename);
+    if (err != KRES_OK) return err;
+    err = reader.read_u32(&out->crc32);
+    if (err != KRES_OK) return err;
+    err = reader.read_u64(&out->size);
+    if (err != KRES_OK) return err;
+    err = reader.read_bytes(out->size, &out->data);
+    if (err != KRES_OK) return err;
+
+    if (stats) stats->record_copy(out->filename.size() + out->size);
+    return KRES_OK;
+}
+
+}  // namespace kres
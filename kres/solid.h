@@ -0,0 +1,80 @@
+#ifndef KRES_SOLID_H
+#define KRES_SOLID_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "main.h"
+
+namespace kres {
+
+// solid archives store entries up to header::solid_entry_limit bytes back to back in blocks listed
+// in header::block_table, records inside a block are ordinary records at ordinary offsets, so any
+// reader can still open them one by one, readers with a block_cache attached pull the whole block
+// in with one read and serve its neighbours from memory
+
+// decoded blocks of a single archive, least recently used ones are dropped once capacity bytes are
+// held, blocks are handed out as shared pointers so an evicted block stays valid for whoever still
+// reads from it, safe to share between threads reading the same archive
+struct block_cache {
+    uint64_t capacity = 4 * 1024 * 1024;
+
+    std::mutex mutex;
+    uint64_t used = 0;
+    std::list<pair<uint64_t, std::shared_ptr<const byte_vec>>> lru;  // most recent first
+    map<uint64_t, decltype(lru)::iterator> blocks;                   // keyed by block offset
+
+    std::shared_ptr<const byte_vec> find(uint64_t block_offset) {
+        std::lock_guard lock(mutex);
+        auto it = blocks.find(block_offset);
+        if (it == blocks.end()) return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void insert(uint64_t block_offset, std::shared_ptr<const byte_vec> block) {
+        std::lock_guard lock(mutex);
+        if (blocks.contains(block_offset)) return;  // another thread got there first
+
+        used += block->size();
+        lru.emplace_front(block_offset, std::move(block));
+        blocks[block_offset] = lru.begin();
+
+        while (used > capacity && lru.size() > 1) {
+            used -= lru.back().second->size();
+            blocks.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+    void clear() {
+        std::lock_guard lock(mutex);
+        lru.clear();
+        blocks.clear();
+        used = 0;
+    }
+};
+
+// turns solid packing on or off for an archive being built, the header is regenerated
+kres_err set_solid_blocks(archive* ar,
+                          bool enabled,
+                          uint64_t entry_limit = 1024,
+                          uint64_t block_size = 64 * 1024);
+
+// the block holding the record at offset, nullptr when it is not part of one
+const solid_block* find_block(const header& h, uint64_t offset);
+
+// reads the record at offset out of block, through ar.cache when one is attached, the archive file
+// is only opened when the block is not cached yet
+kres_err read_block_entry(const archive& ar, const solid_block& block, uint64_t offset, entry* out);
+// same, but recorded into stats instead of ar.stats, for readers with their own (a mount_set)
+kres_err read_block_entry(const archive& ar,
+                          const solid_block& block,
+                          uint64_t offset,
+                          entry* out,
+                          reader_stats* stats);
+
+}  // namespace kres
+
+#endif  // KRES_SOLID_H
@@ -0,0 +1,151 @@
+#ifndef KRES_STATS_H
+#define KRES_STATS_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+#include "types.h"
+
+namespace kres {
+
+// bucket i counts samples in [2^(i-1), 2^i) nanoseconds, bucket 0 is 0ns and the last bucket also
+// takes everything that does not fit (2^38 ns, ~4.6 minutes and up)
+constexpr size_t KRES_STATS_BUCKETS = 40;
+
+using stats_clock = std::chrono::steady_clock;
+
+struct latency_histogram {
+    std::array<std::atomic<uint64_t>, KRES_STATS_BUCKETS> buckets{};
+
+    void record(uint64_t nanos) {
+        size_t bucket = std::bit_width(nanos);
+        if (bucket >= KRES_STATS_BUCKETS) bucket = KRES_STATS_BUCKETS - 1;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// plain copy of reader_stats, safe to pass around and compare between requests
+struct stats_snapshot {
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t bytes_read = 0;    // bytes pulled from archive files
+    uint64_t io_requests = 0;   // reads and seeks asked of archive files, buffered ones included,
+                                // so not every one reaches the kernel
+    uint64_t bytes_copied = 0;  // bytes copied into caller owned buffers (entry data, filenames)
+    uint64_t checksums = 0;
+    uint64_t checksum_nanos = 0;
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+    std::array<uint64_t, KRES_STATS_BUCKETS> lookup_latency{};
+    std::array<uint64_t, KRES_STATS_BUCKETS> read_latency{};
+};
+
+// opt-in counters, attach one to archive::stats (or mount_set::stats) and every operation going
+// through it gets recorded, counters are relaxed atomics so a single instance can be shared between
+// threads reading the same archive
+struct reader_stats {
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> io_requests{0};
+    std::atomic<uint64_t> bytes_copied{0};
+    std::atomic<uint64_t> checksums{0};
+    std::atomic<uint64_t> checksum_nanos{0};
+    std::atomic<uint64_t> cache_hits{0};
+    std::atomic<uint64_t> cache_misses{0};
+    latency_histogram lookup_latency;
+    latency_histogram read_latency;
+
+    void record_lookup(bool hit, uint64_t nanos) {
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        (hit ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+        lookup_latency.record(nanos);
+    }
+
+    void record_io(uint64_t bytes) {
+        io_requests.fetch_add(1, std::memory_order_relaxed);
+        bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void record_copy(uint64_t bytes) { bytes_copied.fetch_add(bytes, std::memory_order_relaxed); }
+
+    void record_checksum(uint64_t nanos) {
+        checksums.fetch_add(1, std::memory_order_relaxed);
+        checksum_nanos.fetch_add(nanos, std::memory_order_relaxed);
+    }
+
+    void record_cache(bool hit) {
+        (hit ? cache_hits : cache_misses).fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+inline uint64_t stats_nanos_since(stats_clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stats_clock::now() - start).count());
+}
+
+// counters are read one by one, so a snapshot taken while other threads are reading is not a single
+// point in time, but every counter in it is exact
+inline stats_snapshot snapshot_stats(const reader_stats& s) {
+    stats_snapshot out;
+    out.lookups = s.lookups.load(std::memory_order_relaxed);
+    out.hits = s.hits.load(std::memory_order_relaxed);
+    out.misses = s.misses.load(std::memory_order_relaxed);
+    out.bytes_read = s.bytes_read.load(std::memory_order_relaxed);
+    out.io_requests = s.io_requests.load(std::memory_order_relaxed);
+    out.bytes_copied = s.bytes_copied.load(std::memory_order_relaxed);
+    out.checksums = s.checksums.load(std::memory_order_relaxed);
+    out.checksum_nanos = s.checksum_nanos.load(std::memory_order_relaxed);
+    out.cache_hits = s.cache_hits.load(std::memory_order_relaxed);
+    out.cache_misses = s.cache_misses.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < KRES_STATS_BUCKETS; i++) {
+        out.lookup_latency[i] = s.lookup_latency.buckets[i].load(std::memory_order_relaxed);
+        out.read_latency[i] = s.read_latency.buckets[i].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+// returns the counters as they were right before the reset
+inline stats_snapshot reset_stats(reader_stats* s) {
+    stats_snapshot out;
+    out.lookups = s->lookups.exchange(0, std::memory_order_relaxed);
+    out.hits = s->hits.exchange(0, std::memory_order_relaxed);
+    out.misses = s->misses.exchange(0, std::memory_order_relaxed);
+    out.bytes_read = s->bytes_read.exchange(0, std::memory_order_relaxed);
+    out.io_requests = s->io_requests.exchange(0, std::memory_order_relaxed);
+    out.bytes_copied = s->bytes_copied.exchange(0, std::memory_order_relaxed);
+    out.checksums = s->checksums.exchange(0, std::memory_order_relaxed);
+    out.checksum_nanos = s->checksum_nanos.exchange(0, std::memory_order_relaxed);
+    out.cache_hits = s->cache_hits.exchange(0, std::memory_order_relaxed);
+    out.cache_misses = s->cache_misses.exchange(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < KRES_STATS_BUCKETS; i++) {
+        out.lookup_latency[i] = s->lookup_latency.buckets[i].exchange(0, std::memory_order_relaxed);
+        out.read_latency[i] = s->read_latency.buckets[i].exchange(0, std::memory_order_relaxed);
+    }
+    return out;
+}
+
+// upper bound in nanoseconds of the bucket holding the q-th quantile, 0 when nothing was recorded
+inline uint64_t histogram_quantile(const std::array<uint64_t, KRES_STATS_BUCKETS>& buckets,
+                                   double q) {
+    uint64_t total = 0;
+    for (uint64_t b : buckets) total += b;
+    if (total == 0) return 0;
+
+    uint64_t target = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < KRES_STATS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) return i == 0 ? 0 : (uint64_t{1} << i) - 1;
+    }
+    return UINT64_MAX;
+}
+
+}  // namespace kres
+
+#endif  // KRES_STATS_H
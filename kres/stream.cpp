@@ -0,0 +1,186 @@
+#include "stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "generation.h"
+
+namespace kres {
+
+// everything comes in through here, bytes already pulled in while looking for the end of the
+// header are handed out first, big reads are grown a chunk at a time so a bogus size fails at the
+// end of the stream instead of allocating it all up front
+struct stream_source {
+    std::istream* in;
+    byte_vec pending;
+    size_t pending_pos = 0;
+
+    kres_err read(void* dst, uint64_t count) {
+        auto p = static_cast<char*>(dst);
+        uint64_t from_pending = std::min<uint64_t>(count, pending.size() - pending_pos);
+        std::memcpy(p, pending.data() + pending_pos, from_pending);
+        pending_pos += from_pending;
+        count -= from_pending;
+        if (count == 0) return KRES_OK;
+
+        in->read(p + from_pending, static_cast<std::streamsize>(count));
+        if (static_cast<uint64_t>(in->gcount()) != count) {
+            return in->eof() ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
+        }
+        return KRES_OK;
+    }
+
+    // appends count bytes to out
+    kres_err append(uint64_t count, byte_vec* out) {
+        constexpr uint64_t chunk = 1024 * 1024;
+        while (count > 0) {
+            uint64_t n = std::min(count, chunk);
+            size_t start = out->size();
+            out->resize(start + n);
+            auto err = read(out->data() + start, n);
+            if (err != KRES_OK) {
+                out->resize(start);
+                return err;
+            }
+            count -= n;
+        }
+        return KRES_OK;
+    }
+
+    kres_err read_u32(uint32_t* out) {
+        std::byte raw[4];
+        auto err = read(raw, 4);
+        if (err == KRES_OK) *out = load_le32(raw);
+        return err;
+    }
+
+    kres_err read_u64(uint64_t* out) {
+        std::byte raw[8];
+        auto err = read(raw, 8);
+        if (err == KRES_OK) *out = load_le64(raw);
+        return err;
+    }
+};
+
+// superblock archives say how long their header is, older ones are read in growing steps until it
+// parses, so buf can end up holding the start of the records as well
+static kres_err parse_streamed_header(stream_source* src, header* h, byte_vec* buf) {
+    auto err = src->append(KRES_FIXED_HEADER_SIZE, buf);
+    if (err != KRES_OK) return err;
+    if (load_le32(buf->data()) != KRES_MAGIC) return KRES_ERROR_INVALID_ARCHIVE;
+
+    if (load_le32(buf->data() + 8) & KRES_FLAG_SUPERBLOCK) {
+        err = src->append(KRES_SUPERBLOCK_SIZE - KRES_FIXED_HEADER_SIZE, buf);
+        if (err != KRES_OK) return err;
+        uint64_t size = load_le64(buf->data() + KRES_FIXED_HEADER_SIZE);
+        if (size < KRES_SUPERBLOCK_SIZE) return KRES_ERROR_INVALID_ARCHIVE;
+        err = src->append(size - KRES_SUPERBLOCK_SIZE, buf);
+        if (err != KRES_OK) return err;
+        return parse_index(*buf, h, true);
+    }
+
+    bool eof = false;
+    for (uint64_t step = 64 * 1024;; step *= 2) {
+        *h = header{};
+        err = parse_index(*buf, h, true);
+        if (err != KRES_ERROR_BUFFER_OVERFLOW) return err;
+        if (eof) return KRES_ERROR_EOF;
+
+        // short reads are fine here, the archive may simply end within this step
+        size_t start = buf->size();
+        buf->resize(start + step);
+        src->in->read(reinterpret_cast<char*>(buf->data() + start),
+                      static_cast<std::streamsize>(step));
+        buf->resize(start + static_cast<size_t>(src->in->gcount()));
+        if (src->in->bad()) return KRES_ERROR_FAILED_IO;
+        eof = src->in->eof();
+    }
+}
+
+// the header is read into its own buffer (pending has to stay empty meanwhile) that then becomes
+// pending, the records start at header_size in it
+static kres_err read_header(stream_source* src, header* h) {
+    byte_vec buf;
+    auto err = parse_streamed_header(src, h, &buf);
+    src->pending = std::move(buf);
+    src->pending_pos = 0;
+    return err;
+}
+
+kres_err stream_archive(std::istream& in, const stream_callback& on_entry, header* header_out) {
+    if (!on_entry) return KRES_INVALID_STATE;
+
+    stream_source src;
+    src.in = &in;
+    header local;
+    header& h = header_out ? *header_out : local;  // filled before the first entry comes out
+    {
+        trace_scope trace("header_parse");
+        auto err = read_header(&src, &h);
+        if (err != KRES_OK) return err;
+    }
+    if (h.flags & KRES_FLAG_VOLUMES) return KRES_INVALID_STATE;
+    if (h.flags & KRES_FLAG_GENERATIONS) {
+        // later generations are indexed at the end of the file, which a stream only reaches last
+        root_slot root;
+        if (h.root_offset + 2 * KRES_ROOT_SLOT_SIZE > src.pending.size() ||
+            !latest_root_slot(src.pending.data() + h.root_offset, &root)) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        if (root.generation != 0) return KRES_INVALID_STATE;
+    }
+
+    uint64_t offset = header_size(h);
+    if (offset > src.pending.size()) return KRES_ERROR_INVALID_ARCHIVE;
+    src.pending_pos = offset;
+
+    // records follow each other, so each has to end where the next one in the table starts, the
+    // last one is only bounded by the stream running out
+    vec<uint64_t> starts;
+    starts.reserve(h.offset_table.size());
+    for (const auto& [e_id, at] : h.offset_table) starts.push_back(at);
+    std::sort(starts.begin(), starts.end());
+
+    entry e;
+    byte_vec name;
+    for (uint64_t i = 0; i < h.entry_count; i++) {
+        auto next = std::upper_bound(starts.begin(), starts.end(), offset);
+        uint64_t room = next == starts.end() ? UINT64_MAX : *next - offset;
+
+        auto err = src.read_u32(&e.filename_len);
+        if (err != KRES_OK) return err;
+
+        // u32 length, u32 crc and u64 size around the name, all of it widened before adding up
+        uint64_t name_size = uint64_t{e.filename_len} + 1;
+        if (room < 16 || name_size > room - 16) return KRES_ERROR_INVALID_ARCHIVE;
+        name.clear();
+        err = src.append(name_size, &name);
+        if (err != KRES_OK) return err;
+        if (name.back() != std::byte{0}) return KRES_ERROR_INVALID_ARCHIVE;
+        e.filename.assign(reinterpret_cast<const char*>(name.data()), name_size - 1);
+
+        id e_id = generate_id(e.filename);
+        auto it = h.offset_table.find(e_id);
+        if (it == h.offset_table.end() || it->second != offset) return KRES_ERROR_INVALID_ARCHIVE;
+
+        err = src.read_u32(&e.crc32);
+        if (err != KRES_OK) return err;
+        err = src.read_u64(&e.size);
+        if (err != KRES_OK) return err;
+        if (e.size > room - 16 - name_size) return KRES_ERROR_INVALID_ARCHIVE;
+
+        trace_scope trace("entry_read", e_id);
+        e.data.clear();
+        err = src.append(e.size, &e.data);
+        if (err != KRES_OK) return err;
+        if (!validate_entry(e)) return KRES_ERROR_ENTRY_CORRUPTED;
+
+        offset += record_size(e);
+        err = on_entry(e);
+        if (err != KRES_OK) return err;
+    }
+
+    return KRES_OK;
+}
+
+}  // namespace kres
@@ -0,0 +1,28 @@
+#ifndef KRES_STREAM_H
+#define KRES_STREAM_H
+
+#include <istream>
+
+#include "main.h"
+
+namespace kres {
+
+// reads an archive front to back from a stream that can't seek (a pipe, a socket, a decompressor),
+// the header is parsed first, then every record is handed to on_entry in file order as soon as its
+// bytes are in and its crc checked, so unpacking can run while the archive is still arriving
+//
+// the entry passed to on_entry is reused for the next record, move its data out to keep it, a
+// callback returning anything but KRES_OK stops the stream with that error, records that don't
+// match the index fail with KRES_ERROR_INVALID_ARCHIVE, corrupted ones with
+// KRES_ERROR_ENTRY_CORRUPTED and a stream that ends early with KRES_ERROR_EOF, split archives
+// (see volume.h) are rejected with KRES_INVALID_STATE since their records aren't in the stream,
+// header_out (user section included) is filled in before the first entry
+using stream_callback = std::function<kres_err(entry& e)>;
+
+kres_err stream_archive(std::istream& in,
+                        const stream_callback& on_entry,
+                        header* header_out = nullptr);
+
+}  // namespace kres
+
+#endif  // KRES_STREAM_H
@@ -0,0 +1,52 @@
+#include "trace.h"
+
+namespace kres {
+
+static std::atomic<trace_sink*> g_trace_sink{nullptr};
+static std::atomic<uint64_t> g_next_thread_id{1};
+
+void set_trace_sink(trace_sink* sink) { g_trace_sink.store(sink, std::memory_order_release); }
+
+trace_sink* get_trace_sink() { return g_trace_sink.load(std::memory_order_acquire); }
+
+uint64_t trace_thread_id() {
+    thread_local uint64_t tid = g_next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    return tid;
+}
+
+chrome_trace_writer::chrome_trace_writer(std::ostream* out, uint32_t pid) : out(out), pid(pid) {
+    *out << "{\"traceEvents\":[\n";
+}
+
+chrome_trace_writer::~chrome_trace_writer() { finish(); }
+
+void chrome_trace_writer::record(const trace_event& ev) {
+    std::lock_guard lock(mutex);
+    if (finished) return;
+
+    // ts and dur are in microseconds, keep the nanosecond part as fraction
+    if (!first) *out << ",\n";
+    first = false;
+    *out << "{\"name\":\"" << ev.name << "\",\"cat\":\"kres\",\"ph\":\"X\",\"pid\":" << pid
+         << ",\"tid\":" << ev.thread_id << ",\"ts\":" << ev.start_nanos / 1000 << '.'
+         << std::to_string(1000 + ev.start_nanos % 1000).substr(1)
+         << ",\"dur\":" << ev.duration_nanos / 1000 << '.'
+         << std::to_string(1000 + ev.duration_nanos % 1000).substr(1)
+         << ",\"args\":{\"arg\":";
+    // ids are full 64 bit hashes, json numbers lose precision past 2^53
+    if (ev.arg < (uint64_t{1} << 53)) {
+        *out << ev.arg << "}}";
+    } else {
+        *out << '"' << ev.arg << "\"}}";
+    }
+}
+
+void chrome_trace_writer::finish() {
+    std::lock_guard lock(mutex);
+    if (finished) return;
+    finished = true;
+    *out << "\n]}\n";
+    out->flush();
+}
+
+}  // namespace kres
@@ -0,0 +1,86 @@
+#ifndef KRES_TRACE_H
+#define KRES_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+#include "stats.h"
+#include "types.h"
+
+namespace kres {
+
+// a single finished span, timestamps come from std::chrono::steady_clock so they line up with any
+// spans the host application records from the same clock
+struct trace_event {
+    const char* name;       // static string, e.g. "read_entry"
+    uint64_t start_nanos;   // steady_clock time since epoch
+    uint64_t duration_nanos;
+    uint64_t thread_id;     // small sequential id per thread, stable for the thread's lifetime
+    uint64_t arg;           // phase specific: entry id, byte count, entry count...
+};
+
+// receives every span while installed, may be called concurrently from any thread that is using
+// kres, so implementations have to do their own locking
+struct trace_sink {
+    virtual ~trace_sink() = default;
+    virtual void record(const trace_event& ev) = 0;
+};
+
+// installs the process wide sink, nullptr disables tracing again (the default), the sink has to
+// outlive every operation that could still be running when it's removed
+void set_trace_sink(trace_sink* sink);
+trace_sink* get_trace_sink();
+
+uint64_t trace_thread_id();
+
+// records a span from construction to destruction, costs a single atomic load when no sink is set
+struct trace_scope {
+    trace_sink* sink;
+    const char* name;
+    uint64_t arg;
+    stats_clock::time_point start;
+
+    explicit trace_scope(const char* name, uint64_t arg = 0)
+        : sink(get_trace_sink()), name(name), arg(arg) {
+        if (sink) start = stats_clock::now();
+    }
+
+    ~trace_scope() {
+        if (!sink) return;
+        auto end = stats_clock::now();
+        trace_event ev;
+        ev.name = name;
+        ev.start_nanos = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count());
+        ev.duration_nanos = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        ev.thread_id = trace_thread_id();
+        ev.arg = arg;
+        sink->record(ev);
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+};
+
+// writes chrome/perfetto json trace events ("ph":"X" complete events), load the output in
+// chrome://tracing or ui.perfetto.dev, call finish (or destroy the writer) to close the json
+struct chrome_trace_writer : trace_sink {
+    std::ostream* out;
+    uint32_t pid;
+    std::mutex mutex;
+    bool first = true;
+    bool finished = false;
+
+    explicit chrome_trace_writer(std::ostream* out, uint32_t pid = 1);
+    ~chrome_trace_writer() override;
+
+    void record(const trace_event& ev) override;
+    void finish();
+};
+
+}  // namespace kres
+
+#endif  // KRES_TRACE_H
@@ -21,6 +21,7 @@ enum kres_err {
     KRES_ERROR_FAILED_IO,
     KRES_ERROR_EOF,
     KRES_ERROR_INVALID_INPUT_FILE,
+    KRES_ERROR_CANCELLED,
 };
 
 template <typename T>
@@ -1,6 +1,9 @@
 #ifndef KRES_UTILITY_H
 #define KRES_UTILITY_H
 
+#include <cstring>
+
+#include "stats.h"
 #include "types.h"
 
 namespace kres {
@@ -25,34 +28,42 @@ inline uint32_t le32_to_host(uint32_t val) { return host_to_le32(val); }
 
 inline uint64_t le64_to_host(uint64_t val) { return host_to_le64(val); }
 
+inline uint32_t load_le32(const std::byte* p) {
+    uint32_t val;
+    std::memcpy(&val, p, 4);
+    return le32_to_host(val);
+}
+
+inline uint64_t load_le64(const std::byte* p) {
+    uint64_t val;
+    std::memcpy(&val, p, 8);
+    return le64_to_host(val);
+}
+
+// appends little endian fields to buffer, reserve the final size up front (see serialized_size) and
+// every write is a single bulk copy into already allocated memory
 struct byte_writer {
     byte_vec* buffer;
 
+    void write_raw(const void* data, size_t len) {
+        auto bytes = static_cast<const std::byte*>(data);
+        buffer->insert(buffer->end(), bytes, bytes + len);
+    }
+
     void write_u32(uint32_t val) {
         val = host_to_le32(val);
-        buffer->push_back(static_cast<std::byte>(val & 0xFF));
-        buffer->push_back(static_cast<std::byte>((val >> 8) & 0xFF));
-        buffer->push_back(static_cast<std::byte>((val >> 16) & 0xFF));
-        buffer->push_back(static_cast<std::byte>((val >> 24) & 0xFF));
+        write_raw(&val, 4);
     }
 
     void write_u64(uint64_t val) {
         val = host_to_le64(val);
-        for (int i = 0; i < 8; i++) {
-            buffer->push_back(static_cast<std::byte>((val >> (i * 8)) & 0xFF));
-        }
+        write_raw(&val, 8);
     }
 
-    void write_bytes(const byte_vec& data) {
-        buffer->insert(buffer->end(), data.begin(), data.end());
-    }
+    void write_bytes(const byte_vec& data) { write_raw(data.data(), data.size()); }
 
-    void write_string(const string& str) {
-        for (char c : str) {
-            buffer->push_back(static_cast<std::byte>(c));
-        }
-        buffer->push_back(std::byte{0});
-    }
+    // includes the null terminator
+    void write_string(const string& str) { write_raw(str.c_str(), str.length() + 1); }
 };
 
 struct byte_reader {
@@ -103,10 +114,13 @@ struct byte_reader {
 
 struct file_reader {
     std::ifstream file;
+    reader_stats* stats = nullptr;     // optional, counts every request issued to the file
+    uint64_t known_size = UINT64_MAX;  // filled by the first size() after open
 
     file_reader() {}
 
     kres_err open(const char* path) {
+        known_size = UINT64_MAX;
         file.open(path, std::ios::binary);
         if (!file.is_open()) return KRES_ERROR_INVALID_INPUT_FILE;
         return KRES_OK;
@@ -123,6 +137,7 @@ struct file_reader {
     kres_err read_u32(uint32_t* out) {
         uint8_t buf[4];
         file.read(reinterpret_cast<char*>(buf), 4);
+        if (stats) stats->record_io(file.gcount());
         if (file.gcount() != 4) {
             return file.eof() ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
         }
@@ -135,6 +150,7 @@ struct file_reader {
     kres_err read_u64(uint64_t* out) {
         uint8_t buf[8];
         file.read(reinterpret_cast<char*>(buf), 8);
+        if (stats) stats->record_io(file.gcount());
         if (file.gcount() != 8) {
             return file.eof() ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
         }
@@ -152,6 +168,10 @@ struct file_reader {
         while (file.get(c) && c != 0) {
             *out += c;
         }
+        if (stats) {
+            stats->record_io(out->size() + 1);
+            stats->record_copy(out->size());
+        }
         if (file.bad()) return KRES_ERROR_FAILED_IO;
         return KRES_OK;
     }
@@ -160,6 +180,10 @@ struct file_reader {
         out->resize(count);
         file.read(reinterpret_cast<char*>(out->data()), count);
         size_t read = file.gcount();
+        if (stats) {
+            stats->record_io(read);
+            stats->record_copy(read);
+        }
         if (read != count) {
             out->resize(read);
             return file.eof() ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
@@ -167,6 +191,36 @@ struct file_reader {
         return KRES_OK;
     }
 
+    // same as read_bytes, but into memory the caller already owns
+    kres_err read_into(void* dst, size_t count) {
+        file.read(static_cast<char*>(dst), static_cast<std::streamsize>(count));
+        size_t read = file.gcount();
+        if (stats) {
+            stats->record_io(read);
+            stats->record_copy(read);
+        }
+        if (read != count) return file.eof() ? KRES_ERROR_EOF : KRES_ERROR_FAILED_IO;
+        return KRES_OK;
+    }
+
+    // size of the open file, looked up once and kept, the read position is left where it was
+    kres_err size(uint64_t* out) {
+        if (known_size == UINT64_MAX) {
+            if (stats) stats->record_io(0);
+            auto pos = file.tellg();
+            file.seekg(0, std::ios::end);
+            auto end = file.tellg();
+            file.seekg(pos);
+            if (pos < 0 || end < 0 || file.fail()) {
+                file.clear();
+                return KRES_ERROR_FAILED_IO;
+            }
+            known_size = static_cast<uint64_t>(end);
+        }
+        *out = known_size;
+        return KRES_OK;
+    }
+
     kres_err tell(size_t* out) {
         auto pos = file.tellg();
         if (pos < 0) return KRES_ERROR_FAILED_IO;
@@ -175,6 +229,7 @@ struct file_reader {
     }
 
     kres_err seek(size_t new_pos) {
+        if (stats) stats->record_io(0);
         file.seekg(static_cast<std::streamoff>(new_pos), std::ios::beg);
         if (file.fail()) {
             file.clear();
@@ -184,6 +239,7 @@ struct file_reader {
     }
 
     kres_err skip(size_t bytes) {
+        if (stats) stats->record_io(0);
         file.seekg(static_cast<std::streamoff>(bytes), std::ios::cur);
         if (file.fail()) {
             file.clear();
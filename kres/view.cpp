@@ -0,0 +1,164 @@
+#include "view.h"
+
+#include <cstring>
+
+#include "generation.h"
+#include "paged.h"
+
+namespace kres {
+
+// parses the header at the start of data, records are looked up relative to data as well
+static kres_err parse_view(std::span<const std::byte> data, archive_view* out) {
+    constexpr size_t fixed = 4 + 4 + 4 + 8;
+    if (data.size() < fixed) return KRES_ERROR_BUFFER_OVERFLOW;
+    if (load_le32(data.data()) != KRES_MAGIC) return KRES_ERROR_INVALID_ARCHIVE;
+
+    archive_view v;
+    v.data = data;
+    v.version = load_le32(data.data() + 4);
+    v.flags = load_le32(data.data() + 8);
+    v.entry_count = load_le64(data.data() + 12);
+
+    if (version_decode(v.version).major != version_decode(KRES_VERSION).major) {
+        return KRES_ERROR_MISMATCHED_VERSION;
+    }
+    if (v.flags & ~KRES_FLAGS_KNOWN) return KRES_ERROR_MISMATCHED_VERSION;
+    if (v.flags & KRES_FLAG_VOLUMES) return KRES_INVALID_STATE;  // records aren't in this buffer
+
+    size_t pos = fixed;
+    uint64_t index = 0;
+    if (v.flags & KRES_FLAG_SUPERBLOCK) {
+        if (data.size() < KRES_SUPERBLOCK_SIZE) return KRES_ERROR_BUFFER_OVERFLOW;
+        index = load_le64(data.data() + fixed + 8);
+        if (index < KRES_SUPERBLOCK_SIZE + 8 || index > data.size()) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+
+        uint32_t crc = load_le32(data.data() + KRES_SUPERBLOCK_SIZE - 4);
+        if (header_crc(data.data(), index) != crc) return KRES_ERROR_INVALID_ARCHIVE;
+        pos = KRES_SUPERBLOCK_SIZE;
+    }
+
+    // a paged index only has its fence here, the pages follow the user section
+    bool paged = v.flags & KRES_FLAG_PAGED_INDEX;
+    size_t fence = pos;
+    if (paged) {
+        if (index == 0) return KRES_ERROR_INVALID_ARCHIVE;
+    } else {
+        if (v.entry_count > (data.size() - pos) / 16) return KRES_ERROR_BUFFER_OVERFLOW;
+
+        v.offset_table.reserve(v.entry_count);
+        for (uint64_t i = 0; i < v.entry_count; i++, pos += 16) {
+            v.offset_table[load_le64(data.data() + pos)] = load_le64(data.data() + pos + 8);
+        }
+    }
+
+    // the user section is the last thing in a superblock header, with its size right before it
+    if (index != 0) pos = index - 8;
+    if (pos + 8 > data.size()) return KRES_ERROR_BUFFER_OVERFLOW;
+    uint64_t user_size = load_le64(data.data() + pos);
+    pos += 8;
+    if (user_size > data.size() - pos) return KRES_ERROR_BUFFER_OVERFLOW;
+    v.user_section = data.subspan(pos, user_size);
+
+    if (paged) {
+        uint64_t page_count = load_le64(data.data() + fence);
+        if (page_count != index_page_count(v.entry_count) ||
+            page_count > (index - fence - 8) / 12) {
+            return KRES_ERROR_INVALID_ARCHIVE;
+        }
+        uint64_t end = pos + user_size + root_area_size(v.flags);
+        uint64_t pages = (end + KRES_INDEX_PAGE_SIZE - 1) / KRES_INDEX_PAGE_SIZE *
+                         KRES_INDEX_PAGE_SIZE;
+        if (pages > data.size() || page_count > (data.size() - pages) / KRES_INDEX_PAGE_SIZE) {
+            return KRES_ERROR_BUFFER_OVERFLOW;
+        }
+
+        v.offset_table.reserve(v.entry_count);
+        for (uint64_t p = 0; p < page_count; p++) {
+            const std::byte* page = data.data() + pages + p * KRES_INDEX_PAGE_SIZE;
+            uint32_t crc = load_le32(data.data() + fence + 8 + p * 12 + 8);
+            if (crc32(page, KRES_INDEX_PAGE_SIZE) != crc) return KRES_ERROR_INVALID_ARCHIVE;
+
+            uint64_t first = p * KRES_INDEX_PAGE_ENTRIES;
+            uint64_t count = std::min(KRES_INDEX_PAGE_ENTRIES, v.entry_count - first);
+            decode_index_page(page, count, &v.offset_table);
+        }
+    }
+
+    *out = std::move(v);
+    return KRES_OK;
+}
+
+kres_err open_archive_view(std::span<const std::byte> data, archive_view* out) {
+    if (!out) return KRES_INVALID_STATE;
+    trace_scope trace("header_parse", data.size());
+
+    archive_view v;
+    auto err = parse_view(data, &v);
+    if (err != KRES_OK) return err;
+    if (!(v.flags & KRES_FLAG_GENERATIONS)) {
+        *out = std::move(v);
+        return KRES_OK;
+    }
+
+    // appended to in place, the root slots follow the user section of generation 0
+    uint64_t root_offset = v.user_section.data() - data.data() + v.user_section.size();
+    if (root_offset + 2 * KRES_ROOT_SLOT_SIZE > data.size()) return KRES_ERROR_BUFFER_OVERFLOW;
+    std::byte area[2 * KRES_ROOT_SLOT_SIZE];
+    std::memcpy(area, data.data() + root_offset, sizeof(area));
+
+    // a buffer mapped while a commit was going on can end before the newest index, the one before
+    // it is then still complete
+    root_slot root;
+    int which = 0;
+    if (!latest_root_slot(area, &root, &which)) return KRES_ERROR_INVALID_ARCHIVE;
+    auto held = [&] {
+        return root.index_offset <= data.size() &&
+               root.index_size <= data.size() - root.index_offset;
+    };
+    if (!held()) {
+        std::memset(area + which * KRES_ROOT_SLOT_SIZE, 0, KRES_ROOT_SLOT_SIZE);
+        if (!latest_root_slot(area, &root) || !held()) return KRES_ERROR_BUFFER_OVERFLOW;
+    }
+
+    if (root.index_offset != 0) {
+        err = parse_view(data.subspan(root.index_offset), &v);
+        if (err != KRES_OK) return err;
+        v.data = data;  // record offsets are absolute
+    }
+    *out = std::move(v);
+    return KRES_OK;
+}
+
+kres_err read_entry(const archive_view& v, id entry_id, entry_view* out) {
+    auto it = v.offset_table.find(entry_id);
+    if (it == v.offset_table.end()) return KRES_ERROR_ENTRY_NOT_FOUND;
+
+    const std::byte* base = v.data.data();
+    uint64_t size = v.data.size();
+    uint64_t pos = it->second;
+
+    if (pos > size || size - pos < 4) return KRES_ERROR_BUFFER_OVERFLOW;
+    uint32_t filename_len = load_le32(base + pos);
+    pos += 4;
+
+    if (size - pos < uint64_t{filename_len} + 1 + 4 + 8) return KRES_ERROR_BUFFER_OVERFLOW;
+    out->filename_len = filename_len;
+    out->filename = std::string_view(reinterpret_cast<const char*>(base + pos), filename_len);
+    pos += filename_len + 1;
+
+    out->crc32 = load_le32(base + pos);
+    out->size = load_le64(base + pos + 4);
+    pos += 12;
+
+    if (out->size > size - pos) return KRES_ERROR_BUFFER_OVERFLOW;
+    out->data = v.data.subspan(pos, out->size);
+    return KRES_OK;
+}
+
+kres_err read_entry(const archive_view& v, const string& filename, entry_view* out) {
+    return read_entry(v, generate_id(filename), out);
+}
+
+}  // namespace kres
@@ -0,0 +1,31 @@
+#ifndef KRES_VIEW_H
+#define KRES_VIEW_H
+
+#include <span>
+
+#include "arena.h"
+
+namespace kres {
+
+// read only view over a complete archive already in memory (embedded with kres_embed, or mapped by
+// the caller), entries are served as views into that memory so nothing is read or copied
+struct archive_view {
+    std::span<const std::byte> data;
+
+    uint32_t version = 0;
+    uint32_t flags = 0;
+    uint64_t entry_count = 0;
+    map<id, uint64_t> offset_table;
+    std::span<const std::byte> user_section;
+};
+
+// parses the header in place, data has to outlive the view, split archives (see volume.h) can't be
+// viewed since their records live in other files
+kres_err open_archive_view(std::span<const std::byte> data, archive_view* out);
+
+kres_err read_entry(const archive_view& v, id entry_id, entry_view* out);
+kres_err read_entry(const archive_view& v, const string& filename, entry_view* out);
+
+}  // namespace kres
+
+#endif  // KRES_VIEW_H
@@ -0,0 +1,49 @@
+#include "volume.h"
+
+#include <cstdio>
+
+namespace kres {
+
+string volume_path(const string& path, uint64_t volume) {
+    if (volume == 0) return path;
+
+    char suffix[24];
+    std::snprintf(suffix, sizeof(suffix), ".%03llu", static_cast<unsigned long long>(volume));
+    return path + suffix;
+}
+
+kres_err set_volume_size(archive* ar, uint64_t cap) {
+    if (!ar) return KRES_ERROR_INVALID_ARCHIVE;
+
+    uint32_t flags = ar->header.flags;
+    uint64_t previous_cap = ar->header.volume_size_cap;
+    if (cap > 0) {
+        ar->header.flags |= KRES_FLAG_VOLUMES;
+    } else {
+        ar->header.flags &= ~KRES_FLAG_VOLUMES;
+    }
+    ar->header.volume_size_cap = cap;
+
+    auto err = make_header(ar);
+    if (err != KRES_OK) {
+        ar->header.flags = flags;
+        ar->header.volume_size_cap = previous_cap;
+    }
+    return err;
+}
+
+kres_err check_volumes(const archive& ar) {
+    const header& h = ar.header;
+    if (!(h.flags & KRES_FLAG_VOLUMES)) return KRES_OK;
+    if (ar.path.empty()) return KRES_ERROR_INVALID_ARCHIVE;
+
+    std::error_code ec;
+    for (uint64_t v = 1; v < h.volume_sizes.size(); v++) {
+        uint64_t size = std::filesystem::file_size(volume_path(ar.path, v), ec);
+        if (ec) return KRES_ERROR_INVALID_ARCHIVE_FILE;
+        if (size != h.volume_sizes[v]) return KRES_ERROR_INVALID_ARCHIVE;
+    }
+    return KRES_OK;
+}
+
+}  // namespace kres
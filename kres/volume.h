@@ -0,0 +1,42 @@
+#ifndef KRES_VOLUME_H
+#define KRES_VOLUME_H
+
+#include "main.h"
+
+namespace kres {
+
+// split archives keep the whole index in the archive file itself (volume 0) and their records in
+// volume files next to it, <path>.001, <path>.002 ..., each kept under header::volume_size_cap,
+// offsets in the offset and block tables carry the volume in their top 16 bits and the position
+// inside that volume file below, so archives without volumes read exactly as before, a record or a
+// solid block never straddles two volumes, one bigger than the cap just gets a volume of its own
+//
+// header::volume_sizes holds the expected size of every volume file, the index one included, volume
+// files are only opened when something is read from them
+
+constexpr uint32_t KRES_VOLUME_SHIFT = 48;
+constexpr uint64_t KRES_VOLUME_LOCAL_MASK = (uint64_t(1) << KRES_VOLUME_SHIFT) - 1;
+constexpr uint64_t KRES_MAX_VOLUMES = (uint64_t(1) << (64 - KRES_VOLUME_SHIFT)) - 1;  // record ones
+
+constexpr uint64_t volume_offset(uint64_t volume, uint64_t local) {
+    return (volume << KRES_VOLUME_SHIFT) | local;
+}
+constexpr uint64_t offset_volume(uint64_t offset) { return offset >> KRES_VOLUME_SHIFT; }
+constexpr uint64_t offset_local(uint64_t offset) { return offset & KRES_VOLUME_LOCAL_MASK; }
+
+// file holding the given volume of the archive at path, volume 0 is path itself
+string volume_path(const string& path, uint64_t volume);
+
+// splits an archive being built into volumes of at most cap bytes, 0 turns splitting off again,
+// the header is regenerated, serialize_archive then writes every volume file next to the archive,
+// a cap that would need more than KRES_MAX_VOLUMES volumes is rejected with KRES_INVALID_STATE and
+// leaves the archive as it was
+kres_err set_volume_size(archive* ar, uint64_t cap);
+
+// checks that every volume of a preloaded archive exists with the size the index expects, without
+// reading any of them
+kres_err check_volumes(const archive& ar);
+
+}  // namespace kres
+
+#endif  // KRES_VOLUME_H
@@ -0,0 +1,98 @@
+#include <kres.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <future>
+
+using namespace kres;
+
+// smallest possible coroutine type, runs eagerly and reports its result through a future
+struct detached_read {
+    struct promise_type {
+        std::promise<kres_err> result;
+
+        detached_read get_return_object() { return {result.get_future()}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_value(kres_err err) { result.set_value(err); }
+        void unhandled_exception() { result.set_value(KRES_INVALID_STATE); }
+    };
+
+    std::future<kres_err> result;
+};
+
+static string write_async_archive() {
+    archive ar = init_archive();
+    for (int i = 0; i < 200; i++) {
+        entry e;
+        e.filename = "async/" + std::to_string(i) + ".bin";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.assign(i * 3, std::byte(i));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    REQUIRE(make_header(&ar) == KRES_OK);
+
+    string file_path = string(CMAKE_BINARY_DIR) + "/async.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    return file_path;
+}
+
+static detached_read read_one(const async_reader& reader, string filename, entry* out) {
+    co_return co_await reader.read_entry_async(filename, out);
+}
+
+static detached_read read_all(const async_reader& reader,
+                              vec<id> ids,
+                              vec<entry>* out,
+                              std::stop_token stop = {}) {
+    co_return co_await reader.read_entries_async(ids, out, stop);
+}
+
+TEST_CASE("Await single reads", "[async]") {
+    archive ar;
+    REQUIRE(preload_archive(&ar, write_async_archive()) == KRES_OK);
+    thread_pool pool(2);
+    async_reader reader{&ar, &pool};
+
+    // far more coroutines in flight than pool threads
+    vec<entry> entries(64);
+    vec<detached_read> reads;
+    for (int i = 0; i < 64; i++) {
+        reads.push_back(read_one(reader, "async/" + std::to_string(i) + ".bin", &entries[i]));
+    }
+    for (int i = 0; i < 64; i++) {
+        REQUIRE(reads[i].result.get() == KRES_OK);
+        REQUIRE(entries[i].size == static_cast<uint64_t>(i * 3));
+        REQUIRE(validate_entry(entries[i]));
+    }
+
+    entry e;
+    REQUIRE(read_one(reader, "async/missing.bin", &e).result.get() == KRES_ERROR_ENTRY_NOT_FOUND);
+}
+
+TEST_CASE("Await a batch of reads", "[async]") {
+    archive ar;
+    REQUIRE(preload_archive(&ar, write_async_archive()) == KRES_OK);
+    thread_pool pool(4);
+    async_reader reader{&ar, &pool};
+
+    vec<id> ids;
+    for (int i = 199; i >= 0; i--) {
+        ids.push_back(generate_id("async/" + std::to_string(i) + ".bin"));
+    }
+
+    vec<entry> out;
+    REQUIRE(read_all(reader, ids, &out).result.get() == KRES_OK);
+    REQUIRE(out.size() == 200);
+    REQUIRE(out[0].filename == "async/199.bin");
+    REQUIRE(out[199].size == 0);
+    for (const auto& e : out) REQUIRE(validate_entry(e));
+
+    std::stop_source stop;
+    stop.request_stop();
+    REQUIRE(read_all(reader, ids, &out, stop.get_token()).result.get() == KRES_ERROR_CANCELLED);
+
+    ids.push_back(generate_id("async/missing.bin"));
+    REQUIRE(read_all(reader, ids, &out).result.get() == KRES_ERROR_ENTRY_NOT_FOUND);
+}
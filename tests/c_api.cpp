@@ -0,0 +1,88 @@
+#include <kres.h>
+#include <kres_c.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstring>
+
+using namespace kres;
+
+TEST_CASE("Read through the c api", "[capi]") {
+    archive ar = init_archive();
+    string big(50000, 'x');
+    for (size_t i = 0; i < big.size(); i++) big[i] = static_cast<char>('a' + i % 26);
+    // payloads are borrowed, so the list has to outlive the serialization
+    vec<pair<string, string>> files = {
+        {"a.txt", "first"}, {"dir/b.txt", "second"}, {"empty", ""}, {"big.bin", big}};
+    for (const auto& [filename, contents] : files) {
+        auto data = std::as_bytes(std::span(contents.data(), contents.size()));
+        REQUIRE(append_entry(&ar, entry_desc{filename, data}) == KRES_OK);
+    }
+    byte_vec ud(10, std::byte{7});
+    REQUIRE(set_user_data(&ar, ud) == KRES_OK);
+
+    string file_path = string(CMAKE_BINARY_DIR) + "/capi.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    byte_vec in_memory;
+    REQUIRE(serialize_archive(ar, &in_memory) == KRES_OK);
+
+    REQUIRE(kres_api_version() == KRES_C_API_VERSION);
+    REQUIRE(kres_id("dir/b.txt", 9) == generate_id("dir/b.txt"));
+
+    kres_archive* opened[2] = {};
+    REQUIRE(kres_open(file_path.c_str(), &opened[0]) == KRES_C_OK);
+    REQUIRE(kres_open_memory(in_memory.data(), in_memory.size(), &opened[1]) == KRES_C_OK);
+
+    for (kres_archive* c : opened) {
+        REQUIRE(kres_entry_count(c) == 4);
+
+        const void* user = nullptr;
+        uint64_t user_size = 0;
+        REQUIRE(kres_user_section(c, &user, &user_size) == KRES_C_OK);
+        REQUIRE(user_size == 10);
+        REQUIRE(std::memcmp(user, ud.data(), 10) == 0);
+
+        kres_entry e;
+        REQUIRE(kres_lookup_name(c, "dir/b.txt", 9, &e) == KRES_C_OK);
+        REQUIRE(string(e.name) == "dir/b.txt");
+        REQUIRE(e.name_len == 9);
+        REQUIRE(string(static_cast<const char*>(e.data), e.size) == "second");
+        REQUIRE(kres_validate(&e) == 1);
+
+        REQUIRE(kres_lookup(c, generate_id("big.bin"), &e) == KRES_C_OK);
+        REQUIRE(string(static_cast<const char*>(e.data), e.size) == big);
+        REQUIRE(kres_lookup_name(c, "missing", 7, &e) == KRES_C_ERROR_ENTRY_NOT_FOUND);
+
+        // too small a buffer reports the size needed
+        char small[4];
+        uint64_t size = 0;
+        REQUIRE(kres_read_into(c, generate_id("big.bin"), small, sizeof(small), &size) ==
+                KRES_C_ERROR_BUFFER_OVERFLOW);
+        REQUIRE(size == big.size());
+        string copy(size, '\0');
+        REQUIRE(kres_read_into(c, generate_id("big.bin"), copy.data(), copy.size(), &size) ==
+                KRES_C_OK);
+        REQUIRE(copy == big);
+        REQUIRE(kres_read_into(c, generate_id("empty"), nullptr, 0, &size) == KRES_C_OK);
+        REQUIRE(size == 0);
+    }
+    kres_close(opened[0]);
+    kres_close(opened[1]);
+
+    // a flipped payload byte is caught on the copy
+    in_memory[in_memory.size() - 1] ^= std::byte{1};
+    kres_archive* damaged = nullptr;
+    REQUIRE(kres_open_memory(in_memory.data(), in_memory.size(), &damaged) == KRES_C_OK);
+    kres_entry last;
+    REQUIRE(kres_lookup(damaged, generate_id(ar.entries.back().filename), &last) == KRES_C_OK);
+    REQUIRE(kres_validate(&last) == 0);
+    byte_vec buf(last.size);
+    uint64_t size = 0;
+    REQUIRE(kres_read_into(damaged, generate_id(ar.entries.back().filename), buf.data(), buf.size(),
+                           &size) == KRES_C_ERROR_ENTRY_CORRUPTED);
+    kres_close(damaged);
+
+    kres_archive* none = nullptr;
+    REQUIRE(kres_open((file_path + ".missing").c_str(), &none) ==
+            KRES_C_ERROR_INVALID_ARCHIVE_FILE);
+    REQUIRE(none == nullptr);
+}
@@ -0,0 +1,34 @@
+#include <kres.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include "test_resources.h"
+
+using namespace kres;
+using namespace kres::literals;
+
+static_assert(const_id("") == 0x2D06800538D394C2ULL);
+static_assert("config/settings.json"_id == const_id("config/settings.json"));
+
+TEST_CASE("Compile time ids match runtime ids", "[embed]") {
+    REQUIRE(const_id("hello.txt") == generate_id("hello.txt"));
+    string long_path(1000, 'x');
+    REQUIRE(const_id(long_path) == generate_id(long_path));
+}
+
+TEST_CASE("Read embedded archive", "[embed]") {
+    archive_view v;
+    REQUIRE(open_archive_view(kres::embedded::test_resources(), &v) == KRES_OK);
+    REQUIRE(v.entry_count == 2);
+
+    entry_view e;
+    REQUIRE(read_entry(v, "hello.txt", &e) == KRES_OK);
+    REQUIRE(string(reinterpret_cast<const char*>(e.data.data()), e.data.size()) ==
+            "hello from kres\n");
+    REQUIRE(validate_entry(e));
+
+    constexpr id settings = "config/settings.json"_id;
+    REQUIRE(read_entry(v, settings, &e) == KRES_OK);
+    REQUIRE(e.filename == "config/settings.json");
+
+    REQUIRE(read_entry(v, "missing", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+}
@@ -0,0 +1,198 @@
+#include <kres.h>
+#include <catch2/catch_test_macros.hpp>
+
+using namespace kres;
+
+static entry make_entry(const string& filename, const string& contents) {
+    entry e;
+    e.filename = filename;
+    e.filename_len = static_cast<uint32_t>(filename.length());
+    for (char c : contents) e.data.push_back(std::byte(c));
+    e.size = e.data.size();
+    e.crc32 = crc32(e.data.data(), e.size);
+    return e;
+}
+
+static string write_archive(const string& name, const vec<entry>& entries) {
+    archive arch = init_archive();
+    arch.entries = entries;
+    REQUIRE(make_header(&arch) == KRES_OK);
+
+    string file_path = string(CMAKE_BINARY_DIR) + "/" + name;
+    REQUIRE(serialize_archive(arch, file_path) == KRES_OK);
+    return file_path;
+}
+
+TEST_CASE("Mount layered archives", "[mount]") {
+    string base = write_archive(
+        "mount_base.kres", {make_entry("a.txt", "base a"), make_entry("b.txt", "base b")});
+    string patch = write_archive("mount_patch.kres", {make_entry("b.txt", "patched b")});
+    string mod = write_archive("mount_mod.kres", {make_entry("c.txt", "mod c")});
+
+    REQUIRE(validate_archive(base));
+    REQUIRE_FALSE(validate_archive(string(CMAKE_BINARY_DIR) + "/mount_missing.kres"));
+
+    mount_set ms;
+    REQUIRE(mount_archives(&ms, {{patch, 10}, {base, 0}, {mod, 5}}) == KRES_OK);
+    REQUIRE(ms.layers.size() == 3);
+
+    entry e;
+    REQUIRE(mount_read_entry(ms, "a.txt", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("a.txt", "base a").data);
+    REQUIRE(validate_entry(e));
+
+    REQUIRE(mount_read_entry(ms, "b.txt", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("b.txt", "patched b").data);
+
+    mount_hit hit;
+    REQUIRE(mount_find(ms, "c.txt", &hit) == KRES_OK);
+    REQUIRE(ms.layers[hit.layer].priority == 5);
+
+    REQUIRE(mount_find(ms, "missing.txt", &hit) == KRES_ERROR_ENTRY_NOT_FOUND);
+}
+
+TEST_CASE("Mounted lookups are a single probe of the merged index", "[mount]") {
+    vec<string> paths;
+    for (int layer = 0; layer < 8; layer++) {
+        vec<entry> entries;
+        for (int i = 0; i < 100; i++) {
+            entries.push_back(make_entry("e/" + std::to_string(i), std::to_string(layer)));
+        }
+        entries.push_back(make_entry("only/" + std::to_string(layer), "only"));
+        paths.push_back(write_archive("mount_probe_" + std::to_string(layer) + ".kres", entries));
+    }
+
+    mount_set ms;
+    vec<pair<string, int32_t>> archives;
+    for (int layer = 0; layer < 8; layer++) archives.push_back({paths[layer], layer});
+    REQUIRE(mount_archives(&ms, archives) == KRES_OK);
+    REQUIRE(ms.paged.empty());
+    REQUIRE(ms.index.size() == 108);  // one winning hit per id, not one per layer
+
+    // lookups never go back to the layers, so they still resolve with every layer table dropped
+    for (auto& layer : ms.layers) layer.ar.header.offset_table.clear();
+    mount_hit hit;
+    REQUIRE(mount_find(ms, "e/17", &hit) == KRES_OK);
+    REQUIRE(ms.layers[hit.layer].priority == 7);
+    REQUIRE(mount_find(ms, "only/3", &hit) == KRES_OK);
+    REQUIRE(ms.layers[hit.layer].priority == 3);
+    REQUIRE(mount_find(ms, "e/100", &hit) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    entry e;
+    REQUIRE(mount_read_entry(ms, "e/17", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("e/17", "7").data);
+}
+
+TEST_CASE("Mount equal priority, later wins", "[mount]") {
+    string first = write_archive("mount_first.kres", {make_entry("x.txt", "first")});
+    string second = write_archive("mount_second.kres", {make_entry("x.txt", "second")});
+
+    mount_set ms;
+    REQUIRE(mount_archives(&ms, {{first, 0}, {second, 0}}) == KRES_OK);
+
+    entry e;
+    REQUIRE(mount_read_entry(ms, "x.txt", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("x.txt", "second").data);
+}
+
+TEST_CASE("Mounted paged layers only read pages their filter lets through", "[mount]") {
+    vec<string> paths;
+    for (int layer = 0; layer < 3; layer++) {
+        archive ar;
+        for (int i = 0; i < 2000; i++) {
+            string name = "l" + std::to_string(layer) + "/" + std::to_string(i);
+            ar.entries.push_back(make_entry(name, name));
+        }
+        ar.entries.push_back(make_entry("shared", "layer " + std::to_string(layer)));
+        REQUIRE(set_id_filter(&ar, true) == KRES_OK);
+        REQUIRE(set_paged_index(&ar, true) == KRES_OK);
+        paths.push_back(string(CMAKE_BINARY_DIR) + "/mount_paged_" + std::to_string(layer) +
+                        ".kres");
+        REQUIRE(serialize_archive(ar, paths.back()) == KRES_OK);
+    }
+
+    mount_set ms;
+    REQUIRE(mount_archives(&ms, {{paths[0], 0}, {paths[1], 1}, {paths[2], 2}}) == KRES_OK);
+    for (const auto& layer : ms.layers) REQUIRE_FALSE(index_loaded(layer.ar.header));
+
+    reader_stats stats;
+    ms.stats = &stats;
+    entry e;
+    REQUIRE(mount_read_entry(ms, "shared", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("shared", "layer 2").data);
+    REQUIRE(mount_read_entry(ms, "l0/1234", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("l0/1234", "l0/1234").data);
+    REQUIRE(stats.hits == 2);
+
+    // misses almost never get past the three filters, so almost no page is read for them
+    reader_stats layer_stats;
+    for (auto& layer : ms.layers) layer.ar.stats = &layer_stats;
+    mount_hit hit;
+    for (int i = 0; i < 1000; i++) {
+        REQUIRE(mount_find(ms, "absent/" + std::to_string(i), &hit) == KRES_ERROR_ENTRY_NOT_FOUND);
+    }
+    REQUIRE(stats.misses == 1000);
+    REQUIRE(layer_stats.bytes_read <= 20 * KRES_INDEX_PAGE_SIZE);
+    for (const auto& layer : ms.layers) REQUIRE_FALSE(index_loaded(layer.ar.header));
+}
+
+TEST_CASE("Paged layers are only asked when they outrank the merged hit", "[mount][paged]") {
+    archive paged;
+    for (int i = 0; i < 2000; i++) {
+        string name = "p/" + std::to_string(i);
+        paged.entries.push_back(make_entry(name, name));
+    }
+    paged.entries.push_back(make_entry("shared", "paged"));
+    REQUIRE(set_id_filter(&paged, true) == KRES_OK);
+    REQUIRE(set_paged_index(&paged, true) == KRES_OK);
+    string paged_path = string(CMAKE_BINARY_DIR) + "/mount_mixed_paged.kres";
+    REQUIRE(serialize_archive(paged, paged_path) == KRES_OK);
+    string loaded = write_archive("mount_mixed_loaded.kres", {make_entry("shared", "loaded")});
+
+    // above the loaded layer the paged one shadows it
+    mount_set ms;
+    REQUIRE(mount_archives(&ms, {{paged_path, 1}, {loaded, 0}}) == KRES_OK);
+    REQUIRE(ms.paged == vec<uint32_t>{0});
+    REQUIRE(ms.index.size() == 1);
+    entry e;
+    REQUIRE(mount_read_entry(ms, "shared", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("shared", "paged").data);
+    REQUIRE(mount_read_entry(ms, "p/42", &e) == KRES_OK);
+
+    // below it, ids the merged index has never reach the paged layer
+    REQUIRE(mount_archives(&ms, {{paged_path, 0}, {loaded, 1}}) == KRES_OK);
+    reader_stats layer_stats;
+    ms.layers[1].ar.stats = &layer_stats;
+    REQUIRE(mount_read_entry(ms, "shared", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("shared", "loaded").data);
+    REQUIRE(layer_stats.bytes_read == 0);
+    REQUIRE(mount_read_entry(ms, "p/42", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("p/42", "p/42").data);
+}
+
+TEST_CASE("Mount stats cover reads out of solid blocks", "[mount][solid]") {
+    archive ar;
+    for (int i = 0; i < 50; i++) {
+        string name = "s/" + std::to_string(i);
+        ar.entries.push_back(make_entry(name, name + " small"));
+    }
+    REQUIRE(set_solid_blocks(&ar, true) == KRES_OK);
+    string path = string(CMAKE_BINARY_DIR) + "/mount_solid.kres";
+    REQUIRE(serialize_archive(ar, path) == KRES_OK);
+
+    mount_set ms;
+    REQUIRE(mount_archives(&ms, {{path, 0}}) == KRES_OK);
+    block_cache cache;
+    ms.layers[0].ar.cache = &cache;
+    reader_stats stats;
+    ms.stats = &stats;
+
+    entry e;
+    REQUIRE(mount_read_entry(ms, "s/3", &e) == KRES_OK);
+    REQUIRE(e.data == make_entry("s/3", "s/3 small").data);
+    REQUIRE(mount_read_entry(ms, "s/40", &e) == KRES_OK);
+    REQUIRE(stats.cache_misses == 1);
+    REQUIRE(stats.cache_hits == 1);
+    REQUIRE(stats.bytes_read > 0);
+    REQUIRE(stats.bytes_copied > 0);
+}
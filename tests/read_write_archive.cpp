@@ -1,11 +1,79 @@
 #include <kres.h>
 #include <catch2/catch_test_macros.hpp>
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 using namespace kres;
 
+// counts global allocations, so a test can check that a read path doesn't make any
+static std::atomic<uint64_t> heap_allocations{0};
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// the 1500 entry archive (dir/file_<i>.bin, i bytes, every 7th empty) most readers are tested on,
+// each test writes its own copy under name so it can run on its own
+static std::string write_file_archive(const std::string& name) {
+    archive ar = init_archive();
+    for (int i = 0; i < 1500; i++) {
+        entry e;
+        e.filename = "dir/file_" + std::to_string(i) + ".bin";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.resize(i % 7 == 0 ? 0 : i);
+        for (size_t b = 0; b < e.data.size(); b++) e.data[b] = std::byte(b * 31 + i);
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        REQUIRE(append_entry(&ar, e) == KRES_OK);
+    }
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/" + name;
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    return file_path;
+}
+
+// the files of write_file_archive laid out as <name>/dir/file_<i>.bin, for the directory packers
+static std::filesystem::path write_source_tree(const std::string& name) {
+    std::filesystem::path root = std::filesystem::path(CMAKE_BINARY_DIR) / name;
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "dir");
+    for (int i = 0; i < 1500; i++) {
+        std::ofstream out(root / ("dir/file_" + std::to_string(i) + ".bin"), std::ios::binary);
+        for (int b = 0; b < (i % 7 == 0 ? 0 : i); b++) out.put(static_cast<char>(b * 31 + i));
+        REQUIRE(out.good());
+    }
+    return root;
+}
+
+// the two entry archive of the create test (test.txt: "hello", foo.bar: "foo") under name
+static std::string write_small_archive(const std::string& name) {
+    archive ar = init_archive();
+    for (auto [filename, contents] : {pair<string, string>{"test.txt", "hello"},
+                                      pair<string, string>{"foo.bar", "foo"}}) {
+        entry e;
+        e.filename = filename;
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        for (char c : contents) e.data.push_back(std::byte(c));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        REQUIRE(append_entry(&ar, e) == KRES_OK);
+    }
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/" + name;
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    return file_path;
+}
+
 TEST_CASE("Create archive", "[archive]") {
     vec<entry> entries;
 
@@ -58,4 +126,1186 @@ TEST_CASE("Read archive", "[archive]") {
         REQUIRE(extract_filename(data, h, entry_id, &filename, &len) == KRES_OK);
         std::cout << "- " << filename << std::endl;
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Reader statistics", "[archive][stats]") {
+    std::string file_path = write_small_archive("stats.kres");
+
+    reader_stats stats;
+    archive ar;
+    ar.stats = &stats;
+    REQUIRE(preload_archive(&ar, file_path) == KRES_OK);
+    reset_stats(&stats);
+
+    entry e;
+    REQUIRE(read_entry(ar, "test.txt", &e) == KRES_OK);
+    REQUIRE(validate_entry(e, &stats));
+    REQUIRE(read_entry(ar, "missing.txt", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    stats_snapshot snap = snapshot_stats(stats);
+    REQUIRE(snap.lookups == 2);
+    REQUIRE(snap.hits == 1);
+    REQUIRE(snap.misses == 1);
+    REQUIRE(snap.checksums == 1);
+    REQUIRE(snap.bytes_copied == string("test.txt").length() + 5);
+    REQUIRE(snap.bytes_read > snap.bytes_copied);
+    REQUIRE(snap.io_requests > 0);
+
+    uint64_t read_samples = 0;
+    for (uint64_t b : snap.read_latency) read_samples += b;
+    REQUIRE(read_samples == 1);
+
+    stats_snapshot before = reset_stats(&stats);
+    REQUIRE(before.lookups == 2);
+    REQUIRE(snapshot_stats(stats).lookups == 0);
+}
+
+TEST_CASE("Trace archive operations", "[archive][trace]") {
+    struct collecting_sink : trace_sink {
+        std::mutex mutex;
+        vec<string> names;
+        void record(const trace_event& ev) override {
+            std::lock_guard lock(mutex);
+            names.push_back(ev.name);
+        }
+    } sink;
+
+    std::string file_path = write_small_archive("trace.kres");
+    set_trace_sink(&sink);
+    archive ar;
+    REQUIRE(preload_archive(&ar, file_path) == KRES_OK);
+    entry e;
+    REQUIRE(read_entry(ar, "foo.bar", &e) == KRES_OK);
+    REQUIRE(validate_entry(e));
+    set_trace_sink(nullptr);
+
+    // spans are recorded when they close, inner phases first
+    REQUIRE(sink.names == vec<string>{"index_build", "header_parse", "entry_read", "checksum"});
+
+    std::ostringstream json;
+    {
+        chrome_trace_writer writer(&json);
+        trace_event ev{"entry_read", 1'500'250, 2'000, 1, 42};
+        writer.record(ev);
+    }
+    REQUIRE(json.str() ==
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"entry_read\",\"cat\":\"kres\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+            "\"ts\":1500.250,\"dur\":2.000,\"args\":{\"arg\":42}}\n]}\n");
+}
+
+TEST_CASE("Serialize archive to file", "[archive]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 1500; i++) {
+        entry e;
+        e.filename = "dir/file_" + std::to_string(i) + ".bin";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.resize(i % 7 == 0 ? 0 : i);
+        for (size_t b = 0; b < e.data.size(); b++) e.data[b] = std::byte(b * 31 + i);
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        REQUIRE(append_entry(&ar, e) == KRES_OK);
+    }
+
+    byte_vec in_memory;
+    REQUIRE(serialize_archive(ar, &in_memory) == KRES_OK);
+    REQUIRE(in_memory.size() == serialized_size(ar));
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/serialized.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == in_memory.size());
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(loaded.header.entry_count == 1500);
+
+    entry e;
+    REQUIRE(read_entry(loaded, "dir/file_1499.bin", &e) == KRES_OK);
+    REQUIRE(e.data == ar.entries[1499].data);
+    REQUIRE(validate_entry(e));
+    REQUIRE(read_entry(loaded, "dir/file_700.bin", &e) == KRES_OK);
+    REQUIRE(e.size == 0);
+}
+
+TEST_CASE("Build archive from borrowed payloads", "[archive]") {
+    byte_vec blob(4096);
+    for (size_t i = 0; i < blob.size(); i++) blob[i] = std::byte(i * 7);
+
+    archive ar = init_archive();
+    REQUIRE(append_entry(&ar, entry_desc{"borrowed.bin", blob}) == KRES_OK);
+    REQUIRE(append_entry(&ar,
+                         entry_desc{"generated.bin",
+                                    {},
+                                    [](std::span<std::byte> out) {
+                                        for (size_t i = 0; i < out.size(); i++) {
+                                            out[i] = std::byte(i);
+                                        }
+                                        return KRES_OK;
+                                    },
+                                    300}) == KRES_OK);
+    REQUIRE(ar.entries[0].data.empty());
+    REQUIRE(ar.entries[0].view.data() == blob.data());
+
+    byte_vec in_memory;
+    REQUIRE(serialize_archive(ar, &in_memory) == KRES_OK);
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/borrowed.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+
+    std::ifstream in(file_path, std::ios::binary);
+    byte_vec on_disk(in_memory.size());
+    in.read(reinterpret_cast<char*>(on_disk.data()), on_disk.size());
+    REQUIRE(in.gcount() == static_cast<std::streamsize>(in_memory.size()));
+    REQUIRE(on_disk == in_memory);
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    entry e;
+    REQUIRE(read_entry(loaded, "borrowed.bin", &e) == KRES_OK);
+    REQUIRE(e.data == blob);
+    REQUIRE(validate_entry(e));
+    REQUIRE(read_entry(loaded, "generated.bin", &e) == KRES_OK);
+    REQUIRE(e.size == 300);
+    REQUIRE(e.data[299] == std::byte(299 & 0xFF));
+    REQUIRE(validate_entry(e));
+}
+
+TEST_CASE("Read entries into an arena", "[archive][arena]") {
+    archive ar;
+    REQUIRE(preload_archive(&ar, write_file_archive("arena.kres")) == KRES_OK);
+
+    std::byte buffer[16 * 1024];
+    arena mem(buffer, sizeof(buffer));
+
+    vec<id> ids = {generate_id("dir/file_900.bin"),
+                   generate_id("dir/file_3.bin"),
+                   generate_id("dir/file_1200.bin")};
+    std::pmr::vector<entry_view> views(&mem);
+    REQUIRE(read_entries(ar, ids, &mem, &views) == KRES_OK);
+    REQUIRE(views.size() == 3);
+    REQUIRE(views[0].filename == "dir/file_900.bin");
+    REQUIRE(views[1].filename == "dir/file_3.bin");
+    REQUIRE(views[1].size == 3);
+    REQUIRE(views[2].size == 1200);
+    for (const auto& v : views) REQUIRE(validate_entry(v));
+
+    entry_view single;
+    REQUIRE(read_entry(ar, "dir/file_5.bin", &mem, &single) == KRES_OK);
+    REQUIRE(single.data.size() == 5);
+    REQUIRE(single.data[4] == std::byte(4 * 31 + 5));
+
+    // a single read takes memory from mem and nowhere else
+    std::byte small[4096];
+    arena single_mem(small, sizeof(small), std::pmr::null_memory_resource());
+    id single_id = generate_id("dir/file_1200.bin");
+    uint64_t before = heap_allocations.load();
+    kres_err err = read_entry(ar, single_id, &single_mem, &single);
+    uint64_t after = heap_allocations.load();
+    REQUIRE(err == KRES_OK);
+    REQUIRE(after == before);
+    REQUIRE(single.size == 1200);
+    REQUIRE(validate_entry(single));
+
+    ids.push_back(generate_id("missing"));
+    REQUIRE(read_entries(ar, ids, &mem, &views) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    // lengths past the end of the file are rejected before the arena is asked for them
+    uint64_t last = ar.header.offset_table[generate_id("dir/file_1499.bin")];
+    for (uint64_t field : {last, last + 4 + 18 + 4}) {
+        archive bad;
+        std::string bad_path = write_file_archive("arena_bad.kres");
+        {
+            std::fstream f(bad_path, std::ios::binary | std::ios::in | std::ios::out);
+            f.seekp(static_cast<std::streamoff>(field));
+            f.write("\xff\xff\xff\xff", 4);
+        }
+        REQUIRE(preload_archive(&bad, bad_path) == KRES_OK);
+        vec<id> bad_ids = {generate_id("dir/file_1499.bin")};
+        std::pmr::vector<entry_view> bad_views(&mem);
+        REQUIRE(read_entries(bad, bad_ids, &mem, &bad_views) == KRES_ERROR_INVALID_ARCHIVE);
+        REQUIRE(read_entry(bad, "dir/file_1499.bin", &mem, &single) == KRES_ERROR_INVALID_ARCHIVE);
+    }
+}
+
+TEST_CASE("Repack archive by access profile", "[archive][profile]") {
+    access_recorder rec;
+    archive ar;
+    ar.recorder = &rec;
+    REQUIRE(preload_archive(&ar, write_file_archive("profile.kres")) == KRES_OK);
+
+    entry e;
+    for (const char* name : {"dir/file_1400.bin", "dir/file_9.bin", "dir/file_1400.bin",
+                             "dir/file_600.bin"}) {
+        REQUIRE(read_entry(ar, name, &e) == KRES_OK);
+    }
+    REQUIRE(rec.order.size() == 3);
+
+    std::string profile_path = std::string(CMAKE_BINARY_DIR) + "/boot.profile";
+    REQUIRE(save_access_profile(&rec, profile_path) == KRES_OK);
+    vec<id> order;
+    REQUIRE(load_access_profile(profile_path, &order) == KRES_OK);
+    REQUIRE(order == rec.order);
+
+    std::string repacked_path = std::string(CMAKE_BINARY_DIR) + "/repacked.kres";
+    REQUIRE(repack_archive(ar, order, repacked_path) == KRES_OK);
+
+    archive repacked;
+    REQUIRE(preload_archive(&repacked, repacked_path) == KRES_OK);
+    REQUIRE(repacked.header.entry_count == ar.header.entry_count);
+
+    uint64_t first = header_size(repacked.header);
+    REQUIRE(repacked.header.offset_table[order[0]] == first);
+    REQUIRE(repacked.header.offset_table[order[1]] > first);
+    REQUIRE(repacked.header.offset_table[order[2]] > repacked.header.offset_table[order[1]]);
+
+    for (const char* name : {"dir/file_9.bin", "dir/file_1000.bin"}) {
+        entry original, moved;
+        REQUIRE(read_entry(ar, name, &original) == KRES_OK);
+        REQUIRE(read_entry(repacked, name, &moved) == KRES_OK);
+        REQUIRE(moved.data == original.data);
+        REQUIRE(validate_entry(moved));
+    }
+}
+
+TEST_CASE("Prefetch entries", "[archive][prefetch]") {
+    archive ar;
+    REQUIRE(preload_archive(&ar, write_file_archive("prefetch.kres")) == KRES_OK);
+
+    prefetcher p;
+    REQUIRE(prefetch(p, vec<id>{}) == KRES_INVALID_STATE);
+    REQUIRE(open_prefetcher(ar, &p) == KRES_OK);
+    REQUIRE(p.offsets.size() == ar.header.entry_count);
+
+    vec<id> ids = {generate_id("dir/file_10.bin"),
+                   generate_id("dir/file_11.bin"),
+                   generate_id("dir/file_1499.bin"),
+                   generate_id("missing")};
+    REQUIRE(prefetch(p, ids) == KRES_OK);
+
+    entry e;
+    REQUIRE(read_entry(ar, "dir/file_1499.bin", &e) == KRES_OK);
+    REQUIRE(validate_entry(e));
+}
+
+TEST_CASE("Extract archive to directory", "[archive][extract]") {
+    archive ar;
+    REQUIRE(preload_archive(&ar, write_file_archive("extract.kres")) == KRES_OK);
+
+    std::filesystem::path out = std::filesystem::path(CMAKE_BINARY_DIR) / "extracted";
+    std::filesystem::remove_all(out);
+    REQUIRE(extract_all(ar, out.string(), 4) == KRES_OK);
+
+    REQUIRE(std::filesystem::file_size(out / "dir/file_1499.bin") == 1499);
+    REQUIRE(std::filesystem::file_size(out / "dir/file_7.bin") == 0);
+
+    std::ifstream in(out / "dir/file_20.bin", std::ios::binary);
+    byte_vec data(20);
+    in.read(reinterpret_cast<char*>(data.data()), 20);
+    entry e;
+    REQUIRE(read_entry(ar, "dir/file_20.bin", &e) == KRES_OK);
+    REQUIRE(data == e.data);
+
+    std::filesystem::path subset = std::filesystem::path(CMAKE_BINARY_DIR) / "extracted_prefix";
+    std::filesystem::remove_all(subset);
+    REQUIRE(extract_prefix(ar, "dir/file_14", subset.string(), 2) == KRES_OK);
+    size_t count = 0;
+    for (const auto& file : std::filesystem::directory_iterator(subset / "dir")) {
+        REQUIRE(file.path().filename().string().starts_with("file_14"));
+        count++;
+    }
+    REQUIRE(count == 111);  // 14, 140-149, 1400-1499
+}
+
+TEST_CASE("Pack a directory with deferred entries", "[archive]") {
+    std::filesystem::path src = write_source_tree("pack_src");
+
+    archive deferred = init_archive();
+    REQUIRE(append_entry(&deferred, src.string(), true, true) == KRES_OK);
+    REQUIRE(deferred.entries.size() == 1500);
+    REQUIRE(deferred.entries[0].data.empty());
+    REQUIRE(!deferred.entries[0].source_path.empty());
+
+    archive eager = init_archive();
+    REQUIRE(append_entry(&eager, src.string(), true) == KRES_OK);
+
+    std::string deferred_path = std::string(CMAKE_BINARY_DIR) + "/deferred.kres";
+    REQUIRE(serialize_archive(deferred, deferred_path) == KRES_OK);
+    byte_vec deferred_mem, eager_mem;
+    REQUIRE(serialize_archive(deferred, &deferred_mem) == KRES_OK);
+    REQUIRE(serialize_archive(eager, &eager_mem) == KRES_OK);
+    REQUIRE(deferred_mem == eager_mem);
+    std::ifstream in(deferred_path, std::ios::binary);
+    byte_vec on_disk(eager_mem.size() + 1);
+    in.read(reinterpret_cast<char*>(on_disk.data()), on_disk.size());
+    on_disk.resize(in.gcount());
+    REQUIRE(on_disk == eager_mem);
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, deferred_path) == KRES_OK);
+    entry e;
+    REQUIRE(read_entry(loaded, "dir/file_1234.bin", &e) == KRES_OK);
+    REQUIRE(e.size == 1234);
+    REQUIRE(validate_entry(e));
+
+    REQUIRE(append_entry(&eager, src.string(), true) == KRES_ERROR_DUPLICATE_ENTRY);
+    REQUIRE(eager.entries.size() == 1500);
+}
+
+TEST_CASE("Solid blocks for small entries", "[archive][solid]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 1500; i++) {
+        entry e;
+        e.filename = "dir/file_" + std::to_string(i) + ".bin";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.resize(i % 7 == 0 ? 0 : i);
+        for (size_t b = 0; b < e.data.size(); b++) e.data[b] = std::byte(b * 31 + i);
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        REQUIRE(append_entry(&ar, e) == KRES_OK);
+    }
+    REQUIRE(set_solid_blocks(&ar, true, 1024, 16 * 1024) == KRES_OK);
+    REQUIRE(ar.header.flags & KRES_FLAG_SOLID);
+    REQUIRE(ar.header.block_table.size() > 1);
+
+    byte_vec in_memory;
+    REQUIRE(serialize_archive(ar, &in_memory) == KRES_OK);
+    REQUIRE(in_memory.size() == serialized_size(ar));
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/solid.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == in_memory.size());
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(loaded.header.block_table.size() == ar.header.block_table.size());
+    REQUIRE(loaded.header.offset_table == ar.header.offset_table);
+
+    // without a cache records are still read one by one
+    entry e;
+    REQUIRE(read_entry(loaded, "dir/file_1499.bin", &e) == KRES_OK);
+    REQUIRE(e.data == ar.entries[1499].data);
+
+    block_cache cache;
+    reader_stats stats;
+    loaded.cache = &cache;
+    loaded.stats = &stats;
+    for (int i = 0; i < 1500; i++) {
+        REQUIRE(read_entry(loaded, "dir/file_" + std::to_string(i) + ".bin", &e) == KRES_OK);
+        REQUIRE(e.data == ar.entries[i].data);
+        REQUIRE(validate_entry(e));
+    }
+
+    uint64_t small = 0;
+    for (const auto& entry : ar.entries) small += entry.size <= 1024;
+
+    // one read per block, every other small entry comes out of the cache
+    auto snap = snapshot_stats(stats);
+    REQUIRE(snap.cache_misses == ar.header.block_table.size());
+    REQUIRE(snap.cache_hits == small - snap.cache_misses);
+    uint64_t large_offset = loaded.header.offset_table[generate_id("dir/file_1499.bin")];
+    REQUIRE(find_block(loaded.header, large_offset) == nullptr);
+}
+
+TEST_CASE("Id filter rejects absent entries", "[archive][filter]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 5000; i++) {
+        entry e;
+        e.filename = "cfg/" + std::to_string(i) + ".ini";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.resize(i % 100);
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    REQUIRE(set_id_filter(&ar, true) == KRES_OK);
+    REQUIRE(set_solid_blocks(&ar, true) == KRES_OK);  // both optional sections at once
+    REQUIRE(ar.header.id_filter.size() == filter_block_count(5000));
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/filtered.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == serialized_size(ar));
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(loaded.header.flags & KRES_FLAG_ID_FILTER);
+
+    vec<filter_block> filter;
+    REQUIRE(load_id_filter(file_path, &filter) == KRES_OK);
+    REQUIRE(filter.size() == loaded.header.id_filter.size());
+    REQUIRE(std::memcmp(filter.data(), ar.header.id_filter.data(),
+                        filter.size() * sizeof(filter_block)) == 0);
+
+    for (int i = 0; i < 5000; i++) {
+        REQUIRE(filter_may_contain(filter, generate_id("cfg/" + std::to_string(i) + ".ini")));
+    }
+    entry e;
+    REQUIRE(read_entry(loaded, "cfg/4999.ini", &e) == KRES_OK);
+    REQUIRE(e.size == 99);
+
+    int passed = 0;
+    for (int i = 0; i < 100000; i++) {
+        passed += filter_may_contain(filter, generate_id("missing/" + std::to_string(i)));
+    }
+    REQUIRE(passed < 500);  // well under 1%
+    REQUIRE(read_entry(loaded, "missing/0", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    // the same archive without the section
+    REQUIRE(set_id_filter(&ar, false) == KRES_OK);
+    std::string unfiltered_path = std::string(CMAKE_BINARY_DIR) + "/unfiltered.kres";
+    REQUIRE(serialize_archive(ar, unfiltered_path) == KRES_OK);
+    REQUIRE(load_id_filter(unfiltered_path, &filter) == KRES_OK);
+    REQUIRE(filter.empty());
+    REQUIRE(filter_may_contain(filter, generate_id("anything")));
+}
+
+TEST_CASE("Open through the superblock", "[archive][superblock]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 2000; i++) {
+        entry e;
+        e.filename = "sb/" + std::to_string(i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.assign(i % 50, std::byte(i));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    byte_vec user(3000, std::byte{0x5A});
+    REQUIRE(set_user_data(&ar, user) == KRES_OK);
+    REQUIRE(ar.header.flags & KRES_FLAG_SUPERBLOCK);
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/superblock.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == serialized_size(ar));
+
+    // index is bigger than the speculative first read, so exactly one more read is needed
+    reader_stats stats;
+    archive loaded;
+    loaded.stats = &stats;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(snapshot_stats(stats).io_requests == 2);
+    REQUIRE(loaded.header.offset_table == ar.header.offset_table);
+    REQUIRE(loaded.header.user_section_size == user.size());
+    REQUIRE(loaded.header.user_section.empty());
+
+    byte_vec read_back;
+    REQUIRE(read_user_section(loaded, &read_back) == KRES_OK);
+    REQUIRE(read_back == user);
+    REQUIRE(load_user_section(&loaded) == KRES_OK);
+    REQUIRE(loaded.header.user_section == user);
+
+    entry e;
+    REQUIRE(read_entry(loaded, "sb/1999", &e) == KRES_OK);
+    REQUIRE(e.size == 1999 % 50);
+
+    // any flipped bit in the index is caught before it is used
+    byte_vec raw;
+    REQUIRE(serialize_archive(ar, &raw) == KRES_OK);
+    archive_view view;
+    REQUIRE(open_archive_view(raw, &view) == KRES_OK);
+    REQUIRE(view.user_section.size() == user.size());
+    raw[KRES_SUPERBLOCK_SIZE + 100] ^= std::byte{1};
+    REQUIRE(open_archive_view(raw, &view) == KRES_ERROR_INVALID_ARCHIVE);
+    {
+        std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+    }
+    archive corrupted;
+    REQUIRE(preload_archive(&corrupted, file_path) == KRES_ERROR_INVALID_ARCHIVE);
+
+    // archives without a superblock still open, their user section comes in eagerly
+    ar.header.flags &= ~KRES_FLAG_SUPERBLOCK;
+    REQUIRE(make_header(&ar) == KRES_OK);
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == serialized_size(ar));
+    archive legacy;
+    REQUIRE(preload_archive(&legacy, file_path) == KRES_OK);
+    REQUIRE(legacy.header.user_section == user);
+    REQUIRE(read_entry(legacy, "sb/1999", &e) == KRES_OK);
+    REQUIRE(e.size == 1999 % 50);
+
+    // a flag this version doesn't know means a layout it can't parse
+    raw[10] |= std::byte{0x01};
+    REQUIRE(open_archive_view(raw, &view) == KRES_ERROR_MISMATCHED_VERSION);
+    {
+        std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+    }
+    REQUIRE(preload_archive(&corrupted, file_path) == KRES_ERROR_MISMATCHED_VERSION);
+}
+
+TEST_CASE("Split archives across volumes", "[archive][volume]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 400; i++) {
+        entry e;
+        e.filename = "vol/" + std::to_string(i) + ".bin";
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.resize(i == 123 ? 100 * 1024 : (i * 37) % 3000);  // one entry bigger than the cap
+        for (size_t b = 0; b < e.data.size(); b++) e.data[b] = std::byte(b ^ i);
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    REQUIRE(set_solid_blocks(&ar, true, 1024, 8 * 1024) == KRES_OK);
+    REQUIRE(set_volume_size(&ar, 64 * 1024) == KRES_OK);
+    REQUIRE(ar.header.volume_sizes.size() > 3);
+
+    byte_vec in_memory;
+    REQUIRE(serialize_archive(ar, &in_memory) == KRES_INVALID_STATE);
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/split.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    const auto& sizes = ar.header.volume_sizes;
+    REQUIRE(std::filesystem::file_size(file_path) == sizes[0]);
+    uint64_t total = 0;
+    for (size_t v = 1; v < sizes.size(); v++) {
+        REQUIRE(std::filesystem::file_size(volume_path(file_path, v)) == sizes[v]);
+        if (sizes[v] > 64 * 1024) REQUIRE(sizes[v] == record_size(ar.entries[123]));
+        total += sizes[v];
+    }
+    REQUIRE(sizes[0] + total == serialized_size(ar));
+    REQUIRE(volume_path(file_path, 2) == file_path + ".002");
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(check_volumes(loaded) == KRES_OK);
+    REQUIRE(loaded.header.volume_size_cap == 64 * 1024);
+    REQUIRE(loaded.header.volume_sizes == sizes);
+
+    block_cache cache;
+    loaded.cache = &cache;
+    vec<id> ids;
+    for (int i = 0; i < 400; i++) {
+        entry e;
+        REQUIRE(read_entry(loaded, ar.entries[i].filename, &e) == KRES_OK);
+        REQUIRE(e.data == ar.entries[i].data);
+        ids.push_back(generate_id(ar.entries[i].filename));
+    }
+
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::vector<entry_view> views(&arena);
+    REQUIRE(read_entries(loaded, ids, &arena, &views) == KRES_OK);
+    for (int i = 0; i < 400; i++) REQUIRE(validate_entry(views[i]));
+
+    std::string out_dir = std::string(CMAKE_BINARY_DIR) + "/split_out";
+    std::filesystem::remove_all(out_dir);
+    REQUIRE(extract_all(loaded, out_dir, 4) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(out_dir + "/vol/123.bin") == 100 * 1024);
+
+    // the cap travels with the index, so a repack splits the same way
+    std::string repacked = std::string(CMAKE_BINARY_DIR) + "/split_repacked.kres";
+    REQUIRE(repack_archive(loaded, {}, repacked) == KRES_OK);
+    archive again;
+    REQUIRE(preload_archive(&again, repacked) == KRES_OK);
+    REQUIRE(again.header.volume_size_cap == 64 * 1024);
+    REQUIRE(again.header.volume_sizes.size() > 3);
+
+    std::filesystem::resize_file(volume_path(file_path, 1), sizes[1] - 1);
+    REQUIRE(check_volumes(loaded) == KRES_ERROR_INVALID_ARCHIVE);
+
+    // one record per volume runs out of volume numbers past KRES_MAX_VOLUMES
+    archive many = init_archive();
+    many.entries.resize(KRES_MAX_VOLUMES + 1);
+    for (size_t i = 0; i < many.entries.size(); i++) {
+        many.entries[i].filename = "v" + std::to_string(i);
+        many.entries[i].filename_len = static_cast<uint32_t>(many.entries[i].filename.length());
+    }
+    REQUIRE(set_user_data(&many, byte_vec(4, std::byte{1})) == KRES_OK);
+    REQUIRE(set_volume_size(&many, 1) == KRES_INVALID_STATE);
+    REQUIRE_FALSE(many.header.flags & KRES_FLAG_VOLUMES);
+    REQUIRE(many.header.user_section.size() == 4);
+    many.entries.pop_back();
+    REQUIRE(set_volume_size(&many, 1) == KRES_OK);
+    REQUIRE(offset_volume(many.header.offset_table[generate_id("v65534")]) == KRES_MAX_VOLUMES);
+}
+
+TEST_CASE("Paged index opens without reading the offsets", "[archive][paged]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 3000; i++) {
+        entry e;
+        e.filename = "pg/" + std::to_string(i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.assign(i % 40, std::byte(i));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    REQUIRE(set_user_data(&ar, byte_vec(100, std::byte{7})) == KRES_OK);
+    REQUIRE(set_paged_index(&ar, true) == KRES_OK);
+    REQUIRE(ar.header.flags & KRES_FLAG_SUPERBLOCK);
+    REQUIRE(index_pages_offset(ar.header) % KRES_INDEX_PAGE_SIZE == 0);
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/paged.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    REQUIRE(std::filesystem::file_size(file_path) == serialized_size(ar));
+
+    // 12 pages worth of fence fit into the first read
+    reader_stats stats;
+    archive loaded;
+    loaded.stats = &stats;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    REQUIRE(snapshot_stats(stats).io_requests == 1);
+    REQUIRE(loaded.header.offset_table.empty());
+    REQUIRE(loaded.header.page_fence.size() == index_page_count(3000));
+
+    // every lookup reads its page, unless a cache or a mapping is attached
+    entry e;
+    for (int i = 0; i < 3000; i += 7) {
+        REQUIRE(read_entry(loaded, "pg/" + std::to_string(i), &e) == KRES_OK);
+        REQUIRE(e.size == static_cast<uint64_t>(i % 40));
+    }
+    REQUIRE(read_entry(loaded, "pg/missing", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    block_cache cache;
+    loaded.cache = &cache;
+    uint64_t offset = 0;
+    for (int i = 0; i < 3000; i++) {
+        REQUIRE(find_offset(loaded, generate_id("pg/" + std::to_string(i)), &offset) == KRES_OK);
+        REQUIRE(offset == ar.header.offset_table[generate_id("pg/" + std::to_string(i))]);
+    }
+    REQUIRE(cache.blocks.size() == loaded.header.page_fence.size());
+
+    index_map pages;
+    REQUIRE(map_index_pages(loaded, &pages) == KRES_OK);
+    loaded.cache = nullptr;
+    loaded.index_pages = &pages;
+    REQUIRE(read_entry(loaded, "pg/2999", &e) == KRES_OK);
+    REQUIRE(e.size == 2999 % 40);
+
+    // whole archive operations read the pages in, views and parse_header take them from memory
+    map<id, uint64_t> table;
+    REQUIRE(read_index(loaded, &table) == KRES_OK);
+    REQUIRE(table == ar.header.offset_table);
+    REQUIRE(load_index(&loaded) == KRES_OK);
+    REQUIRE(index_loaded(loaded.header));
+
+    byte_vec raw;
+    REQUIRE(serialize_archive(ar, &raw) == KRES_OK);
+    archive_view view;
+    REQUIRE(open_archive_view(raw, &view) == KRES_OK);
+    REQUIRE(view.offset_table == ar.header.offset_table);
+    entry_view ev;
+    REQUIRE(read_entry(view, generate_id("pg/1234"), &ev) == KRES_OK);
+    REQUIRE(ev.size == 1234 % 40);
+
+    // a flipped bit in a page is caught when the page is read
+    raw[index_pages_offset(ar.header) + 5] ^= std::byte{1};
+    REQUIRE(open_archive_view(raw, &view) == KRES_ERROR_INVALID_ARCHIVE);
+    {
+        std::ofstream out(file_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+    }
+    archive corrupted;
+    REQUIRE(preload_archive(&corrupted, file_path) == KRES_OK);
+    REQUIRE(read_index(corrupted, &table) == KRES_ERROR_INVALID_ARCHIVE);
+
+    // with a filter, batch reads turn absent ids away before any page is read
+    REQUIRE(set_id_filter(&ar, true) == KRES_OK);
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    reader_stats filtered_stats;
+    archive filtered;
+    filtered.stats = &filtered_stats;
+    REQUIRE(preload_archive(&filtered, file_path) == KRES_OK);
+    id absent = generate_id("pg/absent");
+    for (int i = 0; may_contain(filtered.header, absent); i++) {
+        absent = generate_id("pg/absent" + std::to_string(i));
+    }
+    uint64_t requests = snapshot_stats(filtered_stats).io_requests;
+    std::byte buffer[4096];
+    arena mem(buffer, sizeof(buffer));
+    std::pmr::vector<entry_view> views(&mem);
+    vec<id> ids = {absent};
+    REQUIRE(read_entries(filtered, ids, &mem, &views) == KRES_ERROR_ENTRY_NOT_FOUND);
+    REQUIRE(snapshot_stats(filtered_stats).io_requests == requests);
+}
+
+// hands data out a few bytes at a time and refuses to seek, like a pipe
+struct pipe_buf : std::streambuf {
+    const byte_vec& data;
+    size_t pos = 0;
+    char chunk[7];
+
+    explicit pipe_buf(const byte_vec& d) : data(d) {}
+
+    int_type underflow() override {
+        if (pos >= data.size()) return traits_type::eof();
+        size_t n = std::min(sizeof(chunk), data.size() - pos);
+        std::memcpy(chunk, data.data() + pos, n);
+        pos += n;
+        setg(chunk, chunk, chunk + n);
+        return traits_type::to_int_type(chunk[0]);
+    }
+};
+
+TEST_CASE("Stream an archive from a pipe", "[archive][stream]") {
+    archive ar = init_archive();
+    for (int i = 0; i < 500; i++) {
+        entry e;
+        e.filename = "st/" + std::to_string(i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.assign(i % 3 == 0 ? 5000 : i % 60, std::byte(i));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        ar.entries.push_back(std::move(e));
+    }
+    REQUIRE(set_user_data(&ar, byte_vec(300, std::byte{1})) == KRES_OK);
+
+    auto stream_all = [](const byte_vec& raw, vec<entry>* out, header* h) {
+        pipe_buf buf(raw);
+        std::istream in(&buf);
+        return stream_archive(in, [&](entry& e) {
+            out->push_back(std::move(e));
+            return KRES_OK;
+        }, h);
+    };
+
+    // every layout comes out in file order, old headers without a superblock included
+    for (uint32_t flags : {KRES_FLAG_SUPERBLOCK, KRES_FLAG_SOLID | KRES_FLAG_ID_FILTER, 0u,
+                           KRES_FLAG_PAGED_INDEX | KRES_FLAG_SUPERBLOCK}) {
+        ar.header.flags = flags;
+        REQUIRE(make_header(&ar) == KRES_OK);
+        byte_vec raw;
+        REQUIRE(serialize_archive(ar, &raw) == KRES_OK);
+
+        vec<entry> out;
+        header h;
+        REQUIRE(stream_all(raw, &out, &h) == KRES_OK);
+        REQUIRE(out.size() == ar.entries.size());
+        REQUIRE(h.user_section.size() == 300);
+
+        uint64_t last = 0;
+        for (const auto& e : out) {
+            uint64_t offset = ar.header.offset_table[generate_id(e.filename)];
+            REQUIRE(offset > last);
+            last = offset;
+            REQUIRE(e.data == ar.entries[std::stoi(e.filename.substr(3))].data);
+        }
+    }
+
+    byte_vec raw;
+    REQUIRE(serialize_archive(ar, &raw) == KRES_OK);
+    vec<entry> out;
+    byte_vec truncated(raw.begin(), raw.end() - 10);
+    REQUIRE(stream_all(truncated, &out, nullptr) == KRES_ERROR_EOF);
+
+    raw[raw.size() - 1] ^= std::byte{1};
+    out.clear();
+    REQUIRE(stream_all(raw, &out, nullptr) == KRES_ERROR_ENTRY_CORRUPTED);
+    REQUIRE(out.size() == ar.entries.size() - 1);
+
+    // the callback can stop the stream
+    pipe_buf buf(raw);
+    std::istream in(&buf);
+    int seen = 0;
+    auto stop_at_ten = [&](entry&) { return ++seen == 10 ? KRES_INVALID_STATE : KRES_OK; };
+    REQUIRE(stream_archive(in, stop_at_ten) == KRES_INVALID_STATE);
+    REQUIRE(seen == 10);
+
+    // lengths that run past the next record are rejected before anything is allocated for them
+    raw[raw.size() - 1] ^= std::byte{1};
+    uint64_t first = ar.header.offset_table[generate_id("st/0")];
+    for (uint64_t field : {first, first + 4 + 5 + 4}) {
+        byte_vec bad = raw;
+        std::memset(bad.data() + field, 0xFF, 4);
+        out.clear();
+        REQUIRE(stream_all(bad, &out, nullptr) == KRES_ERROR_INVALID_ARCHIVE);
+        REQUIRE(out.empty());
+    }
+
+    // the last record has nothing after it to check against, a wrapped name length included
+    archive single = init_archive();
+    single.entries.push_back(ar.entries[1]);
+    REQUIRE(make_header(&single) == KRES_OK);
+    byte_vec single_raw;
+    REQUIRE(serialize_archive(single, &single_raw) == KRES_OK);
+    std::memset(single_raw.data() + single.header.offset_table.begin()->second, 0xFF, 4);
+    out.clear();
+    REQUIRE(stream_all(single_raw, &out, nullptr) == KRES_ERROR_EOF);
+    REQUIRE(out.empty());
+}
+
+TEST_CASE("Parallel serialization matches the sequential writer", "[archive][parallel]") {
+    std::filesystem::path src = write_source_tree("parallel_src");
+
+    archive ar = init_archive();
+    REQUIRE(append_entry(&ar, src.string(), true, true) == KRES_OK);
+    for (int i = 0; i < 12; i++) {
+        entry e;
+        e.filename = "big/" + std::to_string(i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.size = (i + 1) * 300 * 1024;
+        if (i % 2 == 0) {
+            e.data.resize(e.size);
+            for (size_t b = 0; b < e.size; b++) e.data[b] = std::byte(b * 7 + i);
+            e.crc32 = crc32(e.data.data(), e.size);
+        } else {
+            e.source = [i](std::span<std::byte> out) {
+                for (size_t b = 0; b < out.size(); b++) out[b] = std::byte(b * 13 + i);
+                return KRES_OK;
+            };
+        }
+        REQUIRE(append_entry(&ar, std::move(e)) == KRES_OK);
+    }
+
+    auto read_file = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+
+    std::string seq_path = std::string(CMAKE_BINARY_DIR) + "/sequential.kres";
+    std::string par_path = std::string(CMAKE_BINARY_DIR) + "/parallel.kres";
+    for (int layout = 0; layout < 3; layout++) {
+        if (layout == 1) REQUIRE(set_solid_blocks(&ar, true) == KRES_OK);
+        if (layout == 2) REQUIRE(set_volume_size(&ar, 2 * 1024 * 1024) == KRES_OK);
+
+        REQUIRE(serialize_archive(ar, seq_path) == KRES_OK);
+        for (uint32_t threads : {1u, 4u}) {
+            REQUIRE(serialize_archive_parallel(ar, par_path, threads) == KRES_OK);
+            REQUIRE(read_file(par_path) == read_file(seq_path));
+            for (size_t v = 1; v < ar.header.volume_sizes.size(); v++) {
+                REQUIRE(read_file(volume_path(par_path, v)) == read_file(volume_path(seq_path, v)));
+            }
+        }
+    }
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, par_path) == KRES_OK);
+    entry e;
+    REQUIRE(read_entry(loaded, "big/11", &e) == KRES_OK);
+    REQUIRE(e.size == 12 * 300 * 1024);
+    REQUIRE(validate_entry(e));
+}
+
+TEST_CASE("Incremental build carries unchanged records over", "[archive][build_cache]") {
+    namespace fs = std::filesystem;
+    fs::path src = fs::path(CMAKE_BINARY_DIR) / "incremental_src";
+    fs::remove_all(src);
+    fs::create_directories(src / "sub");
+    auto write_file = [](const fs::path& path, const string& contents) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << contents;
+    };
+    for (int i = 0; i < 300; i++) {
+        write_file(src / (i % 3 == 0 ? "sub" : ".") / ("f" + std::to_string(i)),
+                   string(i * 11, static_cast<char>('a' + i % 26)));
+    }
+
+    auto build = [&](archive* ar) {
+        *ar = init_archive();
+        REQUIRE(append_entry(ar, src.string(), true, true) == KRES_OK);
+        REQUIRE(set_source_meta(ar, true) == KRES_OK);
+    };
+
+    std::string first_path = std::string(CMAKE_BINARY_DIR) + "/incremental_1.kres";
+    archive first;
+    build(&first);
+    REQUIRE(first.header.source_meta_count == 300);
+    first.header.flags &= ~KRES_FLAG_SUPERBLOCK;  // the rows are only found behind one
+    REQUIRE(set_source_meta(&first, true) == KRES_OK);
+    REQUIRE(first.header.flags & KRES_FLAG_SUPERBLOCK);
+    REQUIRE(serialize_archive(first, first_path) == KRES_OK);
+
+    archive previous;
+    REQUIRE(preload_archive(&previous, first_path) == KRES_OK);
+    REQUIRE(previous.header.source_meta_count == 300);
+    REQUIRE(previous.header.source_meta.empty());
+    map<id, file_stat> metas;
+    REQUIRE(load_source_meta(previous, &metas) == KRES_OK);
+    REQUIRE(metas.size() == 300);
+    REQUIRE(metas[generate_id("f4")].size == 44);
+
+    // same size but a new mtime, a new size, one removed and one added
+    write_file(src / "f4", string(44, 'z'));
+    fs::last_write_time(src / "f4", fs::last_write_time(src / "f4") + std::chrono::seconds(10));
+    write_file(src / "f5", "changed");
+    fs::remove(src / "f7");
+    write_file(src / "new", "new file");
+
+    archive second;
+    build(&second);
+    uint64_t reused = 0;
+    REQUIRE(reuse_unchanged(&second, previous, &reused) == KRES_OK);
+    REQUIRE(reused == 297);
+
+    archive fresh;
+    build(&fresh);
+    byte_vec expected, from_reused;
+    REQUIRE(serialize_archive(fresh, &expected) == KRES_OK);
+    REQUIRE(serialize_archive(second, &from_reused) == KRES_OK);
+    REQUIRE(from_reused == expected);
+
+    std::string second_path = std::string(CMAKE_BINARY_DIR) + "/incremental_2.kres";
+    for (int parallel = 0; parallel < 2; parallel++) {
+        if (parallel) {
+            REQUIRE(serialize_archive_parallel(second, second_path, 4) == KRES_OK);
+        } else {
+            REQUIRE(serialize_archive(second, second_path) == KRES_OK);
+        }
+        std::ifstream in(second_path, std::ios::binary);
+        byte_vec on_disk(expected.size() + 1);
+        in.read(reinterpret_cast<char*>(on_disk.data()), on_disk.size());
+        on_disk.resize(in.gcount());
+        REQUIRE(on_disk == expected);
+    }
+
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, second_path) == KRES_OK);
+    entry e;
+    REQUIRE(read_entry(loaded, "f4", &e) == KRES_OK);
+    REQUIRE(e.data == byte_vec(44, std::byte{'z'}));
+    REQUIRE(validate_entry(e));
+    REQUIRE(read_entry(loaded, "sub/f9", &e) == KRES_OK);
+    REQUIRE(e.size == 99);
+    REQUIRE(validate_entry(e));
+    REQUIRE(read_entry(loaded, "f7", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    // a repack keeps the stats, so the build after it can still reuse everything
+    std::string repacked = std::string(CMAKE_BINARY_DIR) + "/incremental_repacked.kres";
+    REQUIRE(repack_archive(loaded, {}, repacked) == KRES_OK);
+    archive again;
+    REQUIRE(preload_archive(&again, repacked) == KRES_OK);
+    REQUIRE(load_source_meta(again, &metas) == KRES_OK);
+    REQUIRE(metas.size() == 300);
+    archive third;
+    build(&third);
+    REQUIRE(reuse_unchanged(&third, again, &reused) == KRES_OK);
+    REQUIRE(reused == 300);
+}
+
+TEST_CASE("Attribute columns are scanned without reading payloads", "[archive][attributes]") {
+    archive ar = init_archive();
+    size_t type_col, size_col, prio_col;
+    REQUIRE(add_attribute_column(&ar, "type", KRES_ATTR_U32, &type_col) == KRES_OK);
+    REQUIRE(add_attribute_column(&ar, "size", KRES_ATTR_U64, &size_col) == KRES_OK);
+    REQUIRE(add_attribute_column(&ar, "priority", KRES_ATTR_U32, &prio_col) == KRES_OK);
+    size_t again;
+    REQUIRE(add_attribute_column(&ar, "size", KRES_ATTR_U64, &again) == KRES_OK);
+    REQUIRE(again == size_col);
+    REQUIRE(add_attribute_column(&ar, "size", KRES_ATTR_U32, &again) == KRES_INVALID_STATE);
+
+    vec<entry> entries;
+    for (uint64_t i = 0; i < 5000; i++) {
+        entry e;
+        e.filename = "attr/" + std::to_string(i);
+        e.filename_len = static_cast<uint32_t>(e.filename.length());
+        e.data.assign(i % 50, std::byte(i));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        e.attributes.resize(3);
+        e.attributes[type_col] = i % 7;
+        e.attributes[size_col] = i * 1000 + (uint64_t{1} << 40);
+        e.attributes[prio_col] = static_cast<uint32_t>(i % 3);
+        if (i % 1000 == 0) e.attributes.clear();  // missing values read as 0
+        entries.push_back(std::move(e));
+    }
+    ar.entries = entries;
+    REQUIRE(make_header(&ar) == KRES_OK);
+    REQUIRE(ar.header.flags & KRES_FLAG_SUPERBLOCK);
+
+    auto expected_matches = [&] {
+        size_t n = 0;
+        for (const auto& e : entries) {
+            if (!e.attributes.empty() && e.attributes[type_col] == 3 &&
+                e.attributes[size_col] > (uint64_t{1} << 40) + 2000000) {
+                n++;
+            }
+        }
+        return n;
+    };
+
+    auto check = [&](const attribute_table& t) {
+        REQUIRE(t.ids.size() == 5000);
+        REQUIRE(std::is_sorted(t.ids.begin(), t.ids.end()));
+        REQUIRE(t.find("priority") == prio_col);
+        REQUIRE(t.find("missing") == SIZE_MAX);
+        REQUIRE(t.u64(type_col).empty());
+
+        auto type = t.u32(type_col);
+        auto size = t.u64(size_col);
+        size_t matches = 0;
+        for (size_t r = 0; r < t.ids.size(); r++) {
+            matches += type[r] == 3 && size[r] > (uint64_t{1} << 40) + 2000000;
+        }
+        REQUIRE(matches == expected_matches());
+
+        size_t row = t.row(generate_id("attr/4321"));
+        REQUIRE(row != SIZE_MAX);
+        REQUIRE(type[row] == 4321 % 7);
+        REQUIRE(t.u32(prio_col)[row] == 4321 % 3);
+        REQUIRE(size[t.row(generate_id("attr/3000"))] == 0);
+        REQUIRE(t.row(generate_id("attr/absent")) == SIZE_MAX);
+    };
+
+    attribute_table table;
+    REQUIRE(load_attributes(ar, &table) == KRES_OK);
+    check(table);
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/attributes.kres";
+    for (int layout = 0; layout < 3; layout++) {
+        if (layout == 1) REQUIRE(set_paged_index(&ar, true) == KRES_OK);
+        if (layout == 2) REQUIRE(set_volume_size(&ar, 32 * 1024) == KRES_OK);
+        REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+
+        archive loaded;
+        REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+        REQUIRE(loaded.header.attribute_columns.size() == 3);
+        REQUIRE(loaded.header.attribute_columns[size_col].name == "size");
+        REQUIRE(loaded.header.attribute_section.empty());
+
+        attribute_table from_disk;
+        REQUIRE(load_attributes(loaded, &from_disk) == KRES_OK);
+        check(from_disk);
+
+        entry e;
+        REQUIRE(read_entry(loaded, "attr/4999", &e) == KRES_OK);
+        REQUIRE(e.data == entries[4999].data);
+    }
+
+    // the repack keeps every value
+    archive loaded;
+    REQUIRE(preload_archive(&loaded, file_path) == KRES_OK);
+    std::string repacked = std::string(CMAKE_BINARY_DIR) + "/attributes_repacked.kres";
+    REQUIRE(repack_archive(loaded, {}, repacked) == KRES_OK);
+    archive again_loaded;
+    REQUIRE(preload_archive(&again_loaded, repacked) == KRES_OK);
+    REQUIRE(load_attributes(again_loaded, &table) == KRES_OK);
+    check(table);
+
+    {
+        std::fstream f(repacked, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(static_cast<std::streamoff>(attribute_section_offset(again_loaded.header) + 8));
+        f.put('\x7f');
+    }
+    REQUIRE(load_attributes(again_loaded, &table) == KRES_ERROR_INVALID_ARCHIVE);
+}
+
+TEST_CASE("Readers keep their generation while a writer appends", "[archive][generation]") {
+    auto make_entry = [](const string& name, const string& contents) {
+        entry e;
+        e.filename = name;
+        e.filename_len = static_cast<uint32_t>(name.length());
+        for (char c : contents) e.data.push_back(std::byte(c));
+        e.size = e.data.size();
+        e.crc32 = crc32(e.data.data(), e.size);
+        return e;
+    };
+    auto contents_of = [](const archive& ar, const string& name) {
+        entry e;
+        auto err = read_entry(ar, name, &e);
+        if (err != KRES_OK) return string("<missing>");
+        REQUIRE(validate_entry(e));
+        return string(reinterpret_cast<const char*>(e.data.data()), e.data.size());
+    };
+    auto read_file = [](const string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        string s = ss.str();
+        auto bytes = std::as_bytes(std::span(s.data(), s.size()));
+        return byte_vec(bytes.begin(), bytes.end());
+    };
+
+    archive ar = init_archive();
+    for (int i = 0; i < 200; i++) {
+        ar.entries.push_back(make_entry("g/" + std::to_string(i), string(i, 'a' + i % 26)));
+    }
+    REQUIRE(set_user_data(&ar, byte_vec(33, std::byte{9})) == KRES_OK);
+    REQUIRE(set_id_filter(&ar, true) == KRES_OK);
+    REQUIRE(set_generations(&ar, true) == KRES_OK);
+    REQUIRE(ar.header.flags & KRES_FLAG_SUPERBLOCK);
+
+    std::string file_path = std::string(CMAKE_BINARY_DIR) + "/generations.kres";
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    byte_vec first_bytes = read_file(file_path);
+
+    archive reader, writer;
+    REQUIRE(preload_archive(&reader, file_path) == KRES_OK);
+    REQUIRE(preload_archive(&writer, file_path) == KRES_OK);
+    REQUIRE(reader.header.generation == 0);
+
+    vec<entry> added = {make_entry("g/5", "replaced"), make_entry("g/new", "added")};
+    REQUIRE(commit_generation(&writer, std::move(added), {generate_id("g/7")}) == KRES_OK);
+    REQUIRE(writer.header.generation == 1);
+    REQUIRE(writer.header.entry_count == 200);
+    REQUIRE(contents_of(writer, "g/5") == "replaced");
+    REQUIRE(contents_of(writer, "g/7") == "<missing>");
+
+    // the reader opened before the commit still sees generation 0 exactly
+    REQUIRE(contents_of(reader, "g/5") == string(5, 'f'));
+    REQUIRE(contents_of(reader, "g/7") == string(7, 'h'));
+    REQUIRE(contents_of(reader, "g/new") == "<missing>");
+    REQUIRE(commit_generation(&reader, {make_entry("g/late", "x")}) == KRES_INVALID_STATE);
+
+    vec<entry> dup = {make_entry("g/d", "1"), make_entry("g/d", "2")};
+    REQUIRE(commit_generation(&writer, std::move(dup)) == KRES_ERROR_DUPLICATE_ENTRY);
+    REQUIRE(commit_generation(&writer, {make_entry("g/second", "two")}) == KRES_OK);
+    REQUIRE(writer.header.generation == 2);
+
+    archive latest;
+    REQUIRE(preload_archive(&latest, file_path) == KRES_OK);
+    REQUIRE(latest.header.generation == 2);
+    REQUIRE(latest.header.entry_count == 201);
+    REQUIRE(contents_of(latest, "g/5") == "replaced");
+    REQUIRE(contents_of(latest, "g/second") == "two");
+    REQUIRE(contents_of(latest, "g/199") == string(199, 'a' + 199 % 26));
+    byte_vec user;
+    REQUIRE(read_user_section(latest, &user) == KRES_OK);
+    REQUIRE(user == byte_vec(33, std::byte{9}));
+
+    vec<filter_block> filter;
+    REQUIRE(load_id_filter(file_path, &filter) == KRES_OK);
+    REQUIRE(filter_may_contain(filter, generate_id("g/second")));
+
+    // views follow the root as well, a buffer taken before a commit or with the newest slot torn
+    // falls back to what it fully holds
+    byte_vec now = read_file(file_path);
+    archive_view v;
+    entry_view ev;
+    REQUIRE(open_archive_view(now, &v) == KRES_OK);
+    REQUIRE(v.entry_count == 201);
+    REQUIRE(read_entry(v, "g/second", &ev) == KRES_OK);
+    REQUIRE(open_archive_view(first_bytes, &v) == KRES_OK);
+    REQUIRE(v.entry_count == 200);
+    REQUIRE(read_entry(v, "g/new", &ev) == KRES_ERROR_ENTRY_NOT_FOUND);
+    now[latest.header.root_offset] ^= std::byte{1};  // generation 2 went to the first slot
+    REQUIRE(open_archive_view(now, &v) == KRES_OK);
+    REQUIRE(read_entry(v, "g/new", &ev) == KRES_OK);
+    REQUIRE(read_entry(v, "g/second", &ev) == KRES_ERROR_ENTRY_NOT_FOUND);
+
+    std::istringstream stream(string(reinterpret_cast<const char*>(now.data()), now.size()));
+    REQUIRE(stream_archive(stream, [](entry&) { return KRES_OK; }) == KRES_INVALID_STATE);
+
+    // readers opening and reading while commits keep landing always get a complete generation
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::thread concurrent([&] {
+        while (!done.load()) {
+            archive a;
+            if (preload_archive(&a, file_path) != KRES_OK) {
+                bad++;
+                continue;
+            }
+            for (const auto& [entry_id, offset] : a.header.offset_table) {
+                entry e;
+                if (read_entry(a, entry_id, &e) != KRES_OK || !validate_entry(e)) bad++;
+            }
+        }
+    });
+    for (int i = 0; i < 20; i++) {
+        vec<entry> more = {make_entry("g/" + std::to_string(i), "gen " + std::to_string(i))};
+        REQUIRE(commit_generation(&writer, std::move(more)) == KRES_OK);
+    }
+    done = true;
+    concurrent.join();
+    REQUIRE(bad == 0);
+    REQUIRE(writer.header.generation == 22);
+    REQUIRE(writer.header.entry_count == 202);  // g/7 is back
+
+    // a repack compacts everything into a single generation 0
+    std::string repacked = std::string(CMAKE_BINARY_DIR) + "/generations_repacked.kres";
+    REQUIRE(repack_archive(writer, {}, repacked) == KRES_OK);
+    archive compact;
+    REQUIRE(preload_archive(&compact, repacked) == KRES_OK);
+    REQUIRE(compact.header.generation == 0);
+    REQUIRE(compact.header.entry_count == 202);
+    REQUIRE(contents_of(compact, "g/3") == "gen 3");
+    REQUIRE(std::filesystem::file_size(repacked) < std::filesystem::file_size(file_path));
+}
@@ -0,0 +1,98 @@
+#include <kres.h>
+#include <catch2/catch_test_macros.hpp>
+
+#ifndef _WIN32
+#include <thread>
+
+#include <sys/socket.h>
+
+using namespace kres;
+
+static string write_remote_archive(const string& name, const vec<pair<string, string>>& files) {
+    archive ar = init_archive();
+    for (const auto& [filename, contents] : files) {
+        auto data = std::as_bytes(std::span(contents.data(), contents.size()));
+        REQUIRE(append_entry(&ar, entry_desc{filename, data}) == KRES_OK);
+    }
+
+    string file_path = string(CMAKE_BINARY_DIR) + "/" + name;
+    REQUIRE(serialize_archive(ar, file_path) == KRES_OK);
+    return file_path;
+}
+
+TEST_CASE("Serve entries over a socket", "[remote]") {
+    string big(100000, 'x');
+    for (size_t i = 0; i < big.size(); i++) big[i] = static_cast<char>('a' + i % 26);
+
+    string base = write_remote_archive(
+        "remote_base.kres", {{"a.txt", "base a"}, {"b.txt", "base b"}, {"big.bin", big}});
+    string patch = write_remote_archive("remote_patch.kres", {{"b.txt", "patched b"}});
+
+    remote_server server;
+    REQUIRE(open_server({base, patch}, &server) == KRES_OK);
+
+    int sv[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    kres_err served = KRES_INVALID_STATE;
+    std::thread worker([&] { served = serve_connection(server, sv[1]); });
+
+    remote_archive client;
+    client.fd = sv[0];
+
+    entry e;
+    REQUIRE(read_entry(client, "a.txt", &e) == KRES_OK);
+    REQUIRE(e.filename == "a.txt");
+    REQUIRE(string(reinterpret_cast<const char*>(e.data.data()), e.size) == "base a");
+    REQUIRE(validate_entry(e));
+
+    REQUIRE(read_entry(client, generate_id("b.txt"), &e) == KRES_OK);
+    REQUIRE(string(reinterpret_cast<const char*>(e.data.data()), e.size) == "patched b");
+
+    REQUIRE(read_entry(client, "big.bin", &e) == KRES_OK);
+    REQUIRE(e.size == big.size());
+    REQUIRE(validate_entry(e));
+
+    byte_vec range;
+    REQUIRE(read_range(client, generate_id("big.bin"), 26 * 100 + 3, 5, &range) == KRES_OK);
+    REQUIRE(string(reinterpret_cast<const char*>(range.data()), range.size()) == "defgh");
+    REQUIRE(read_range(client, generate_id("big.bin"), big.size() - 2, 100, &range) == KRES_OK);
+    REQUIRE(range.size() == 2);
+
+    REQUIRE(read_entry(client, "missing.txt", &e) == KRES_ERROR_ENTRY_NOT_FOUND);
+    REQUIRE(read_entry(client, "a.txt", &e) == KRES_OK);  // still usable after a miss
+
+    close_remote(&client);
+    worker.join();
+    ::close(sv[1]);
+    REQUIRE(served == KRES_OK);
+}
+
+TEST_CASE("Clients reject response lengths before allocating", "[remote]") {
+    // (filename_len, size) a misbehaving server answers with
+    for (auto [name_len, size] : {pair<uint32_t, uint64_t>{0xFFFFFFFF, 1},
+                                  pair<uint32_t, uint64_t>{1, UINT64_MAX}}) {
+        int sv[2];
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+        byte_vec response;
+        byte_writer writer;
+        writer.buffer = &response;
+        writer.write_u32(KRES_OK);
+        writer.write_u32(name_len);
+        if (name_len == 1) {
+            writer.write_raw("a", 2);
+            writer.write_u32(0);
+            writer.write_u64(size);
+        }
+        REQUIRE(::send(sv[1], response.data(), response.size(), 0) ==
+                static_cast<ssize_t>(response.size()));
+
+        remote_archive client;
+        client.fd = sv[0];
+        entry e;
+        REQUIRE(read_entry(client, generate_id("a"), &e) == KRES_ERROR_INVALID_ARCHIVE);
+        REQUIRE(e.data.empty());
+        ::close(sv[1]);
+    }
+}
+#endif
@@ -0,0 +1,158 @@
+// packs a directory into a kres archive, entry names are paths relative to the directory root
+//
+//   kres_pack [options] <dir> <out.kres>
+//   kres_pack [options] --embed <name> <dir> <out_dir>   also writes <name>.cpp/.h for kres_embed
+//
+//   --solid    packs small files into blocks, see solid.h
+//   --filter   stores an id filter in the header, see filter.h
+//   --paged    writes a paged index, see paged.h
+//   --volume-size <bytes>   splits records into <out.kres>.001, .002 ..., see volume.h (not with
+//                           --embed)
+//   --incremental   records file stats, and when <out.kres> is already there copies the records of
+//                   unchanged files over from it, see build_cache.h (not with --embed or
+//                   --volume-size)
+
+#include <kres.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace kres;
+namespace fs = std::filesystem;
+
+static bool write_embed_sources(const string& name, const byte_vec& data, const fs::path& out_dir) {
+    std::ofstream header(out_dir / (name + ".h"), std::ios::trunc);
+    if (!header.is_open()) return false;
+    header << "// generated by kres_pack, do not edit\n"
+              "#pragma once\n\n"
+              "#include <cstddef>\n"
+              "#include <span>\n\n"
+              "namespace kres::embedded {\n"
+              "std::span<const std::byte> " << name << "();\n"
+              "}\n";
+
+    std::ofstream source(out_dir / (name + ".cpp"), std::ios::trunc);
+    if (!source.is_open()) return false;
+    source << "// generated by kres_pack, do not edit\n"
+              "#include \"" << name << ".h\"\n\n"
+              "namespace {\n"
+              "alignas(16) const unsigned char data[] = {";
+
+    static const char digits[] = "0123456789abcdef";
+    string line;
+    for (size_t i = 0; i < data.size(); i++) {
+        if (i % 20 == 0) {
+            source << line << "\n   ";
+            line.clear();
+        }
+        auto b = static_cast<uint8_t>(data[i]);
+        line += " 0x";
+        line += digits[b >> 4];
+        line += digits[b & 0xF];
+        line += ',';
+    }
+    source << line << "\n};\n"
+              "}  // namespace\n\n"
+              "std::span<const std::byte> kres::embedded::" << name << "() {\n"
+              "    return {reinterpret_cast<const std::byte*>(data), sizeof(data)};\n"
+              "}\n";
+
+    return header.good() && source.good();
+}
+
+static void usage() {
+    std::fprintf(stderr,
+                 "usage: kres_pack [options] <dir> <out.kres>\n"
+                 "       kres_pack [options] --embed <name> <dir> <out_dir>\n"
+                 "options: --solid --filter --paged --volume-size <bytes> --incremental\n"
+                 "         (the last two not with --embed, not with each other)\n");
+}
+
+int main(int argc, char** argv) {
+    bool solid = false;
+    bool filter = false;
+    bool paged = false;
+    uint64_t volume_size = 0;
+    bool incremental = false;
+    for (; argc > 1; argc--, argv++) {
+        if (std::strcmp(argv[1], "--solid") == 0) {
+            solid = true;
+        } else if (std::strcmp(argv[1], "--filter") == 0) {
+            filter = true;
+        } else if (std::strcmp(argv[1], "--paged") == 0) {
+            paged = true;
+        } else if (std::strcmp(argv[1], "--volume-size") == 0 && argc > 2) {
+            volume_size = std::strtoull(argv[2], nullptr, 10);
+            argc--, argv++;
+        } else if (std::strcmp(argv[1], "--incremental") == 0) {
+            incremental = true;
+        } else {
+            break;
+        }
+    }
+
+    bool embed = argc == 5 && std::strcmp(argv[1], "--embed") == 0;
+    if ((!embed && argc != 3) || (embed && (volume_size > 0 || incremental)) ||
+        (incremental && volume_size > 0)) {
+        usage();
+        return 1;
+    }
+
+    string name = embed ? argv[2] : "";
+    fs::path root = embed ? argv[3] : argv[1];
+    fs::path out = embed ? argv[4] : argv[2];
+
+    if (!fs::is_directory(root)) {
+        std::fprintf(stderr, "%s is not a directory\n", root.string().c_str());
+        return 1;
+    }
+
+    // deferred entries, file contents are only read while the archive is written
+    archive ar = init_archive();
+    if (append_entry(&ar, root.string(), true, true) != KRES_OK) {
+        std::fprintf(stderr, "failed to read %s\n", root.string().c_str());
+        return 1;
+    }
+    if ((solid && set_solid_blocks(&ar, true) != KRES_OK) ||
+        (filter && set_id_filter(&ar, true) != KRES_OK) ||
+        (paged && set_paged_index(&ar, true) != KRES_OK) ||
+        (volume_size > 0 && set_volume_size(&ar, volume_size) != KRES_OK) ||
+        (incremental && set_source_meta(&ar, true) != KRES_OK)) {
+        std::fprintf(stderr, "invalid options for %s\n", root.string().c_str());
+        return 1;
+    }
+
+    if (!embed) {
+        // the previous build is read from while the new one is written, so that goes next to it and
+        // only replaces it once complete
+        string target = out.string();
+        archive previous;
+        if (incremental && fs::exists(out) && preload_archive(&previous, target) == KRES_OK) {
+            uint64_t reused = 0;
+            if (reuse_unchanged(&ar, previous, &reused) == KRES_OK) {
+                std::fprintf(stderr, "%llu of %zu entries unchanged\n",
+                             static_cast<unsigned long long>(reused), ar.entries.size());
+            }
+            target += ".tmp";
+        }
+
+        std::error_code ec;
+        if (serialize_archive_parallel(ar, target) != KRES_OK ||
+            (target != out.string() && (fs::rename(target, out, ec), ec))) {
+            std::fprintf(stderr, "failed to write %s\n", out.string().c_str());
+            return 1;
+        }
+        return 0;
+    }
+
+    fs::create_directories(out);
+    byte_vec data;
+    if (serialize_archive(ar, &data) != KRES_OK ||
+        serialize_archive(ar, (out / (name + ".kres")).string()) != KRES_OK ||
+        !write_embed_sources(name, data, out)) {
+        std::fprintf(stderr, "failed to write embed sources to %s\n", out.string().c_str());
+        return 1;
+    }
+    return 0;
+}
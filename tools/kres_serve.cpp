@@ -0,0 +1,72 @@
+// keeps archives mounted and serves their entries over a unix domain socket, see kres/remote.h for
+// the protocol and the client side
+//
+//   kres_serve <socket> <archive>...   later archives shadow earlier ones
+
+#include <kres.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace kres;
+
+static char socket_path[sizeof(sockaddr_un::sun_path)];
+
+static void on_exit_signal(int) {
+    ::unlink(socket_path);
+    ::_exit(0);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::fprintf(stderr, "usage: kres_serve <socket> <archive>...\n");
+        return 1;
+    }
+    if (std::strlen(argv[1]) >= sizeof(socket_path)) {
+        std::fprintf(stderr, "socket path too long\n");
+        return 1;
+    }
+    std::strcpy(socket_path, argv[1]);
+
+    remote_server server;
+    if (open_server(vec<string>(argv + 2, argv + argc), &server) != KRES_OK) {
+        std::fprintf(stderr, "failed to open archives\n");
+        return 1;
+    }
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socket_path);
+    ::unlink(socket_path);  // left over from a previous run
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        std::fprintf(stderr, "failed to listen on %s\n", socket_path);
+        return 1;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);  // clients hanging up mid response are just dropped
+    std::signal(SIGINT, on_exit_signal);
+    std::signal(SIGTERM, on_exit_signal);
+
+    // one thread per connection, clients are expected to keep theirs open for many requests
+    for (;;) {
+        int conn = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::fprintf(stderr, "accept failed: %s\n", std::strerror(errno));
+            return 1;
+        }
+
+        std::thread([&server, conn] {
+            serve_connection(server, conn);
+            ::close(conn);
+        }).detach();
+    }
+}